@@ -92,7 +92,7 @@ void Renderer::createCommandBuffers()
     }
 }
 
-VkCommandBuffer Renderer::beginFrame()
+VkCommandBuffer Renderer::beginFrame(std::chrono::steady_clock::time_point newestInput)
 {
     assert(!isFrameStarted && "can't call beginFrame while already in progress");
     auto result = swapChain->acquireNextImage(&currentImageIndex);
@@ -108,6 +108,7 @@ VkCommandBuffer Renderer::beginFrame()
         throw std::runtime_error("failed to acquire swap chain image!");
     }
     isFrameStarted     = true;
+    frameInput         = newestInput;
     auto commandBuffer = getCurrentCommandBuffer();
     vkResetCommandBuffer(commandBuffer, 0);
     VkCommandBufferBeginInfo beginInfo{};
@@ -128,6 +129,11 @@ void Renderer::endFrame()
         throw std::runtime_error("failed to record command buffer!");
     }
     auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+    if (frameInput != std::chrono::steady_clock::time_point{} &&
+        (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR))
+    {
+        inputLatency.recordSince(frameInput);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
     {
         recreateSwapChain();
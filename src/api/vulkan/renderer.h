@@ -1,9 +1,11 @@
 #pragma once
 
+#include "common/latencyTracker.h"
 #include "device.h"
 #include "swapchain.h"
 #include "wsi/wsi.h"
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
@@ -67,7 +69,9 @@ public:
         return currentFrameIndex;
     }
 
-    VkCommandBuffer beginFrame();
+    // newestInput: timestamp of the newest input event that went into this frame, or a default time_point if there
+    // was none. endFrame() records how long it took from there until the frame was handed to present.
+    VkCommandBuffer beginFrame(std::chrono::steady_clock::time_point newestInput = {});
     void endFrame();
     void beginSwapChainRendererPass(VkCommandBuffer commandBuffer);
     void endSwapChainRendererPass(VkCommandBuffer commandBuffer);
@@ -77,6 +81,18 @@ public:
         framebufferResized = true;
     }
 
+    // Input-to-present latency of the recent frames that carried input. The end point is the return from
+    // vkQueuePresentKHR, scanout happens up to a refresh interval (or more with a deeper swapchain) later.
+    LatencyReport inputLatencyReport() const
+    {
+        return inputLatency.report();
+    }
+
+    void resetInputLatency()
+    {
+        inputLatency.reset();
+    }
+
 private:
     void createCommandBuffers();
     void freeCommandBuffers();
@@ -98,6 +114,9 @@ private:
     bool isFrameStarted{ false };
     bool framebufferResized{ false };
 
+    std::chrono::steady_clock::time_point frameInput{};
+    LatencyTracker inputLatency;
+
     [[maybe_unused]] VkDescriptorPool imguiPool = VK_NULL_HANDLE;
 };
 } // namespace ana
@@ -8,7 +8,9 @@
 #include "glm/common.hpp"
 #include "math/math.h"
 #include "rendersystem.h"
+#include "wsi/inputRecording.h"
 #include "wsi/wsi.h"
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <iostream>
@@ -32,12 +34,14 @@
 #include "camera/camera.h"
 
 #include "event/eventManager.h"
+#include "event/inputState.h"
 #include <chrono>
 
 namespace ana
 {
 
-APP::APP()
+APP::APP(AppOptions options)
+    : options(std::move(options))
 {
 }
 
@@ -47,7 +51,15 @@ APP::~APP()
 
 void APP::run()
 {
-    wsi          = ana::wsi::CreateGLFWWSI(WIDTH, HEIGHT, "Anastasia");
+    wsi = ana::wsi::CreateGLFWWSI(WIDTH, HEIGHT, "Anastasia");
+    if (!options.replayInput.empty())
+    {
+        wsi = ana::wsi::CreateReplayWSI(std::move(wsi), options.replayInput);
+    }
+    else if (!options.recordInput.empty())
+    {
+        wsi = ana::wsi::CreateRecordingWSI(std::move(wsi), options.recordInput);
+    }
     device       = std::make_unique<vk::Device>(*wsi);
     renderer     = std::make_unique<Renderer>(*wsi, *device);
     renderSystem = std::make_unique<RenderSystem>(*device, renderer->getSwapChainImageFormat(),
@@ -55,50 +67,15 @@ void APP::run()
 
     loadGameObjects();
 
-    ana::EventManager em{};
-    bool kW = false, kA = false, kS = false, kD = false;
-    bool kShift = false, kUp = false, kDown = false;
-
-    em.registerEvent<KeyboardEvent>(
-        [&](const KeyboardEvent& e)
-        {
-            const bool pressed = (e.m_keystate == ana::KeyState::Pressed || e.m_keystate == ana::KeyState::Repeat);
-            switch (e.m_key)
-            {
-            case ana::Key::W:
-                kW = pressed;
-                break;
-            case ana::Key::A:
-                kA = pressed;
-                break;
-            case ana::Key::S:
-                kS = pressed;
-                break;
-            case ana::Key::D:
-                kD = pressed;
-                break;
-            case ana::Key::LeftShift:
-                kShift = pressed;
-                break;
-            case ana::Key::E:
-                kUp = pressed;
-                break;
-            case ana::Key::Q:
-                kDown = pressed;
-                break;
-            default:
-                break;
-            }
-            return false;
-        });
+    ana::EventManager<KeyboardEvent, MouseMoveEvent, MouseButtonEvent, WindowResizeEvent> em{};
+    // movement keys are polled once per frame, no KeyboardEvent handler on the way
+    InputState input;
+    // newest input consumed since the last frame that started, handed to the renderer for latency tracking
+    std::chrono::steady_clock::time_point newestInput{};
 
     if (wsi)
     {
-        wsi->setKeySink(
-            [&](const KeyboardEvent& e)
-            {
-                em.pushEvent<KeyboardEvent>(e);
-            });
+        wsi->setInputState(&input);
         wsi->setResizeSink(
             [&](const ana::WindowResizeEvent&)
             {
@@ -116,26 +93,39 @@ void APP::run()
     std::cout << "maxPushConstantSize= " << device->properties.limits.maxPushConstantsSize << std::endl;
 
     auto currentTime = std::chrono::high_resolution_clock::now();
+    const auto start = currentTime;
+    uint64_t frames  = 0;
     while (wsi && wsi->poll())
     {
+        // GLFW and present calls posted by other threads since the last frame
+        mainThreadQueue.drain();
         em.processAll();
 
         auto newTime    = std::chrono::high_resolution_clock::now();
         float frameTime = std::chrono::duration<float>(newTime - currentTime).count();
         currentTime     = newTime;
+        // a replay steps the simulation like the recording did, so the camera path is the same on every run
+        if (const auto recorded = wsi->recordedFrameTime())
+        {
+            frameTime = std::chrono::duration<float>(*recorded).count();
+        }
+        ++frames;
 
-        float speed = 2.0f * (kShift ? 3.0f : 1.0f);
-        if (kW)
+        const InputSnapshot& keys = input.snapshot();
+        newestInput               = std::max(newestInput, keys.newestInput());
+
+        float speed = 2.0f * (keys.isDown(Key::LeftShift) ? 3.0f : 1.0f);
+        if (keys.isDown(Key::W))
             eye.z += speed * frameTime;
-        if (kS)
+        if (keys.isDown(Key::S))
             eye.z -= speed * frameTime;
-        if (kA)
+        if (keys.isDown(Key::A))
             eye.x -= speed * frameTime;
-        if (kD)
+        if (keys.isDown(Key::D))
             eye.x += speed * frameTime;
-        if (kUp)
+        if (keys.isDown(Key::E))
             eye.y += speed * frameTime;
-        if (kDown)
+        if (keys.isDown(Key::Q))
             eye.y -= speed * frameTime;
         camera.setLookAt(eye, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
 
@@ -143,8 +133,9 @@ void APP::run()
         PerspectiveInfo perspectiveInfo{ aspect, 50.f, 0.1f, 10.f };
         camera.setProjection(perspectiveInfo);
 
-        if (auto commandBuffer = renderer->beginFrame())
+        if (auto commandBuffer = renderer->beginFrame(newestInput))
         {
+            newestInput = {};
             renderer->beginSwapChainRendererPass(commandBuffer);
             renderSystem->renderGameObjects(commandBuffer, gameObjects, camera);
             renderer->endSwapChainRendererPass(commandBuffer);
@@ -152,6 +143,30 @@ void APP::run()
         }
     }
 
+    // run what is still queued while the window and device are alive
+    mainThreadQueue.drain();
+    if (wsi)
+    {
+        wsi->setInputState(nullptr);
+    }
+
+    if (!options.replayInput.empty() && frames > 0)
+    {
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "replayed " << frames << " frames in " << seconds << "s, " << seconds * 1000.0 / frames
+                  << "ms per frame" << std::endl;
+    }
+    if (const auto latency = renderer->inputLatencyReport(); latency.samples > 0)
+    {
+        const auto ms = [](std::chrono::nanoseconds ns)
+        {
+            return std::chrono::duration<double, std::milli>(ns).count();
+        };
+        std::cout << "input-to-present latency over " << latency.samples << " frames: p50= " << ms(latency.p50)
+                  << "ms p95= " << ms(latency.p95) << "ms p99= " << ms(latency.p99) << "ms max= " << ms(latency.max)
+                  << "ms" << std::endl;
+    }
+
     if (device)
     {
         vkDeviceWaitIdle(device->device());
@@ -6,8 +6,10 @@
 #include "api/vulkan/renderer.h"
 #include "api/vulkan/swapchain.h"
 #include "rendersystem.h"
+#include "threads/mainThreadQueue.h"
 #include "wsi/wsi.h"
 #include <memory>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -15,13 +17,21 @@
 
 namespace ana
 {
+struct AppOptions
+{
+    // write the live input to this file (see wsi/inputRecording.h)
+    std::string recordInput;
+    // drive the app from this recording instead of the keyboard and mouse, quits when it ends
+    std::string replayInput;
+};
+
 class APP
 {
 public:
     static constexpr int WIDTH  = 800;
     static constexpr int HEIGHT = 600;
 
-    APP();
+    explicit APP(AppOptions options = {});
     ~APP();
     APP(const APP&)            = delete;
     APP& operator=(const APP&) = delete;
@@ -30,13 +40,22 @@ public:
 
     void run();
 
+    // Window and present work posted from other threads, run once per frame right after polling the window.
+    MainThreadQueue& mainThread()
+    {
+        return mainThreadQueue;
+    }
+
 private:
     void loadGameObjects();
 
+    AppOptions options;
+
     std::unique_ptr<ana::wsi::IWSI> wsi;
     std::unique_ptr<vk::Device> device;
     std::unique_ptr<Renderer> renderer;
     std::unique_ptr<RenderSystem> renderSystem;
     std::vector<GameObject> gameObjects;
+    MainThreadQueue mainThreadQueue;
 };
 } // namespace ana
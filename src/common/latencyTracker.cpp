@@ -0,0 +1,61 @@
+#include "latencyTracker.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace ana
+{
+
+LatencyTracker::LatencyTracker(std::size_t window)
+    : m_window(window)
+{
+    assert(window > 0 && "LatencyTracker needs room for at least one sample");
+    m_samples.reserve(window);
+}
+
+void LatencyTracker::record(std::chrono::nanoseconds latency)
+{
+    ++m_total;
+    if (m_samples.size() < m_window)
+    {
+        m_samples.push_back(latency.count());
+        return;
+    }
+    m_samples[m_next] = latency.count();
+    m_next            = (m_next + 1) % m_window;
+}
+
+LatencyReport LatencyTracker::report() const
+{
+    LatencyReport report;
+    report.samples = m_samples.size();
+    report.total   = m_total;
+    if (m_samples.empty())
+    {
+        return report;
+    }
+
+    std::vector<std::int64_t> sorted = m_samples;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest rank: the smallest sample with at least p of all samples at or below it
+    const auto percentile = [&](double p)
+    {
+        const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return std::chrono::nanoseconds(sorted[std::max<std::size_t>(rank, 1) - 1]);
+    };
+    report.p50 = percentile(0.50);
+    report.p95 = percentile(0.95);
+    report.p99 = percentile(0.99);
+    report.max = std::chrono::nanoseconds(sorted.back());
+    return report;
+}
+
+void LatencyTracker::reset()
+{
+    m_samples.clear();
+    m_next  = 0;
+    m_total = 0;
+}
+
+} // namespace ana
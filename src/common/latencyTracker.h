@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ana
+{
+
+struct LatencyReport
+{
+    // samples in the window the percentiles are taken over
+    std::size_t samples = 0;
+    // everything recorded since construction or the last reset()
+    std::uint64_t total = 0;
+    std::chrono::nanoseconds p50{};
+    std::chrono::nanoseconds p95{};
+    std::chrono::nanoseconds p99{};
+    std::chrono::nanoseconds max{};
+};
+
+// Percentiles over the last `window` latency samples. Recording is a store into a ring, the sorting happens in
+// report(). Not thread safe, meant to be fed from one loop (e.g. the renderer's frame loop).
+class LatencyTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LatencyTracker(std::size_t window = 1024);
+
+    void record(std::chrono::nanoseconds latency);
+
+    // the time from `since` to now
+    void recordSince(Clock::time_point since)
+    {
+        record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since));
+    }
+
+    [[nodiscard]] LatencyReport report() const;
+    void reset();
+
+private:
+    std::vector<std::int64_t> m_samples;
+    std::size_t m_window;
+    // next slot to overwrite once the window is full
+    std::size_t m_next    = 0;
+    std::uint64_t m_total = 0;
+};
+
+} // namespace ana
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "event/event.h"
+
+namespace ana
+{
+
+// How consecutive queued events of one type fold into one before the handlers see them. merge() folds `next` into
+// `into` and returns true, or returns false to keep both. A merged event keeps the timestamp of `into`, the oldest
+// input it stands for. Specialize for your own event types; the default never merges.
+template <typename TEvent>
+struct EventCoalescing
+{
+    static constexpr bool enabled = false;
+
+    static bool merge(TEvent&, const TEvent&)
+    {
+        return false;
+    }
+};
+
+// deltas add up, the position is the latest one
+template <>
+struct EventCoalescing<MouseMoveEvent>
+{
+    static constexpr bool enabled = true;
+
+    static bool merge(MouseMoveEvent& into, const MouseMoveEvent& next)
+    {
+        into.m_deltaX += next.m_deltaX;
+        into.m_deltaY += next.m_deltaY;
+        into.m_absX = next.m_absX;
+        into.m_absY = next.m_absY;
+        return true;
+    }
+};
+
+// only the final size matters
+template <>
+struct EventCoalescing<WindowResizeEvent>
+{
+    static constexpr bool enabled = true;
+
+    static bool merge(WindowResizeEvent& into, const WindowResizeEvent& next)
+    {
+        into.m_width  = next.m_width;
+        into.m_height = next.m_height;
+        return true;
+    }
+};
+
+// auto-repeats of a key that is already down carry no news, presses and releases always get through
+template <>
+struct EventCoalescing<KeyboardEvent>
+{
+    static constexpr bool enabled = true;
+
+    static bool merge(KeyboardEvent& into, const KeyboardEvent& next)
+    {
+        return next.m_keystate == KeyState::Repeat && next.m_key == into.m_key &&
+               into.m_keystate != KeyState::Released;
+    }
+};
+
+} // namespace ana
@@ -3,6 +3,8 @@
 #include "common/hash.h"
 #include "event.h"
 #include "event/input.h"
+#include <chrono>
+#include <type_traits>
 
 // total 3 event
 
@@ -18,16 +20,25 @@ enum class EventType
     WINDOW_RESIZE
 };
 
+// Common header of the engine events. No vtable: events are trivially copyable values, queues and logs copy them
+// as bytes and never run a destructor.
 class Event
 {
 public:
     explicit Event(EventType type)
-        : m_type(type) {};
+        : m_timestamp(std::chrono::steady_clock::now())
+        , m_type(type) {};
 
-    virtual ~Event() = default;
+    EventType type() const
+    {
+        return m_type;
+    }
+
+    // when the event was created, for GLFWWSI events that is when its callback ran during poll()
+    std::chrono::steady_clock::time_point m_timestamp;
 
 private:
-    [[maybe_unused]] EventType m_type = EventType::UNDEFINED;
+    EventType m_type = EventType::UNDEFINED;
 };
 
 struct MouseButtonEvent : public Event
@@ -90,4 +101,8 @@ struct WindowResizeEvent : public Event
     uint32_t m_height;
 };
 
+static_assert(std::is_trivially_copyable_v<MouseButtonEvent> && std::is_trivially_copyable_v<MouseMoveEvent> &&
+                  std::is_trivially_copyable_v<KeyboardEvent> && std::is_trivially_copyable_v<WindowResizeEvent>,
+              "events are copied as bytes");
+
 } // namespace ana
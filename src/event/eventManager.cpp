@@ -1,19 +1,27 @@
 #include "eventManager.h"
 
+#include <algorithm>
+
 namespace ana
 {
 
-void EventManager::processAll()
+void DynamicEvents::processAll()
 {
-    std::vector<TypeErased*> list;
+    const size_t count = slotCount_.load(std::memory_order_acquire);
+    for (size_t chunk = 0, first = 0; first < count; first += FirstChunk << chunk, ++chunk)
     {
-        std::scoped_lock lk(mapMutex_);
-        list.reserve(map_.size());
-        for (auto& kv : map_)
-            list.push_back(kv.second.get());
+        Slot* slots = chunks_[chunk].load(std::memory_order_acquire);
+        if (!slots)
+        {
+            continue;
+        }
+        const size_t used = std::min(FirstChunk << chunk, count - first);
+        for (size_t i = 0; i < used; ++i)
+        {
+            if (auto* p = slots[i].load(std::memory_order_acquire))
+                p->process();
+        }
     }
-    for (auto* p : list)
-        p->process();
 }
 
 } // namespace ana
@@ -1,53 +1,299 @@
-#include "common/hash.h"
+#pragma once
+
+#include "event/coalescing.h"
+#include "threads/slabPool.h"
+#include "threads/taskGraph.h"
+#include <array>
 #include <atomic>
+#include <bit>
+#include <bitset>
+#include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace ana
 
 {
-class EventManager
+enum class HandlerThreading
 {
+    // only called on the thread that runs processAll()
+    CallerOnly,
+    // may run on a pool worker while handlers of other event types run elsewhere (see EventManager::processAll)
+    ThreadSafe
+};
 
-    template <typename TEvent>
-    struct EventData
+namespace detail
+{
+// Queue and handlers of one event type
+template <typename TEvent>
+class EventQueue
+{
+public:
+    using Handler = std::function<bool(const TEvent&)>;
+
+    struct Node
     {
-        std::mutex mtx;
-        std::queue<TEvent> events;
-        std::vector<std::function<bool(const TEvent&)>> handlers;
+        std::atomic<Node*> next{ nullptr };
+        alignas(TEvent) std::byte storage[sizeof(TEvent)];
 
-        void enqueue(const TEvent& e)
+        TEvent* event()
         {
-            std::scoped_lock lk(mtx);
-            events.push(e);
+            return std::launder(reinterpret_cast<TEvent*>(storage));
         }
+    };
 
-        // 快照处理：不持锁执行用户回调
-        void processSnapshot()
+    struct HandlerList
+    {
+        std::vector<Handler> handlers;
+        // every handler was registered as HandlerThreading::ThreadSafe
+        bool threadSafe = true;
+    };
+
+    EventQueue()
+    {
+        head_.store(tail_, std::memory_order_relaxed);
+    }
+
+    ~EventQueue()
+    {
+        while (Node* next = tail_->next.load(std::memory_order_acquire))
         {
-            std::queue<TEvent> local;
-            std::vector<std::function<bool(const TEvent&)>> hs;
+            next->event()->~TEvent();
+            release(tail_);
+            tail_ = next;
+        }
+        release(tail_);
+        for (const auto* list : retired_)
+        {
+            delete list;
+        }
+        delete handlers_.load(std::memory_order_relaxed);
+    }
+
+    // Vyukov MPSC: one exchange on the head, no lock, nodes come from a slab so steady state doesn't allocate
+    void enqueue(const TEvent& e)
+    {
+        auto* node = ::new (nodes_.allocate()) Node();
+        ::new (static_cast<void*>(node->storage)) TEvent(e);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // RCU style: readers never lock, writers publish a new list and retire the old one
+    void addHandler(Handler&& func, HandlerThreading threading = HandlerThreading::CallerOnly)
+    {
+        std::scoped_lock lk(writeMtx_);
+        const HandlerList* old = handlers_.load(std::memory_order_relaxed);
+        auto* list             = old ? new HandlerList(*old) : new HandlerList();
+        list->handlers.push_back(std::move(func));
+        list->threadSafe = list->threadSafe && threading == HandlerThreading::ThreadSafe;
+        handlers_.store(list, std::memory_order_release);
+        threadSafe_.store(list->threadSafe, std::memory_order_relaxed);
+        if (old)
+        {
+            retired_.push_back(old);
+            hasRetired_.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    // 快照处理：不持锁执行用户回调
+    // Events pushed while processing (also by the handlers) wait for the next call. One consumer per type at a
+    // time, a concurrent call for the same type returns right away.
+    void processSnapshot()
+    {
+        consume(false);
+    }
+
+    // processSnapshot() for a pool worker: leaves the events queued and returns false if a handler that isn't
+    // ThreadSafe got registered in the meantime
+    bool processConcurrent()
+    {
+        return consume(true);
+    }
+
+    // there are handlers and all of them are ThreadSafe. Answered from a copy of the flag, the handler lists
+    // themselves may only be read by the consumer (see reclaim()).
+    bool threadSafe() const
+    {
+        return threadSafe_.load(std::memory_order_relaxed);
+    }
+
+    // only has an effect for types with an EventCoalescing specialization, on by default
+    void setCoalescing(bool enabled)
+    {
+        coalesce_.store(enabled, std::memory_order_relaxed);
+    }
+
+private:
+    bool consume(bool onlyThreadSafe)
+    {
+        if (consuming_.test_and_set(std::memory_order_acquire))
+        {
+            return true;
+        }
+        struct Release
+        {
+            std::atomic_flag& flag;
+
+            ~Release()
             {
-                std::scoped_lock lk(mtx);
-                std::swap(local, events);
-                hs = handlers;
+                flag.clear(std::memory_order_release);
             }
-            while (!local.empty())
+        } guard{ consuming_ };
+        reclaim();
+
+        const HandlerList* list = handlers_.load(std::memory_order_acquire);
+        if (onlyThreadSafe && list && !list->threadSafe)
+        {
+            return false;
+        }
+        process(list);
+        return true;
+    }
+
+    void process(const HandlerList* list)
+    {
+        if constexpr (EventCoalescing<TEvent>::enabled)
+        {
+            if (coalesce_.load(std::memory_order_relaxed))
             {
-                TEvent e = std::move(local.front());
-                local.pop();
-                for (auto& cb : hs)
+                // handlers see one event per run of mergeable ones
+                std::optional<TEvent> pending;
+                drain(
+                    [&](TEvent& e)
+                    {
+                        if (pending && EventCoalescing<TEvent>::merge(*pending, e))
+                        {
+                            return;
+                        }
+                        if (pending)
+                        {
+                            dispatch(list, *pending);
+                        }
+                        pending.emplace(std::move(e));
+                    });
+                if (pending)
                 {
-                    if (cb && cb(e))
-                        break;
+                    dispatch(list, *pending);
                 }
+                return;
             }
         }
-    };
+        drain(
+            [&](TEvent& e)
+            {
+                dispatch(list, e);
+            });
+    }
+
+    // pass every event queued before the call to fn, oldest first
+    template <typename Fn>
+    void drain(Fn&& fn)
+    {
+        // the consumed nodes go back to the slab together at the end (also if a handler throws)
+        typename NodePool::FreeChain freed(nodes_);
+        Node* last = head_.load(std::memory_order_acquire);
+        while (tail_ != last)
+        {
+            // a producer between its exchange and the link: the rest is picked up next time
+            Node* next = tail_->next.load(std::memory_order_acquire);
+            if (!next)
+            {
+                break;
+            }
+            tail_->~Node();
+            freed.add(tail_);
+            tail_ = next;
+
+            // next is the new stub, its event is consumed here (also if a handler throws)
+            struct Consumed
+            {
+                TEvent* e;
+
+                ~Consumed()
+                {
+                    e->~TEvent();
+                }
+            } consumed{ next->event() };
+            fn(*consumed.e);
+        }
+    }
 
+    static void dispatch(const HandlerList* list, const TEvent& e)
+    {
+        if (!list)
+        {
+            return;
+        }
+        for (auto& cb : list->handlers)
+        {
+            if (cb && cb(e))
+                break;
+        }
+    }
+
+    void release(Node* node)
+    {
+        node->~Node();
+        nodes_.deallocate(node);
+    }
+
+    // The consumer is the only reader of the handler lists and holds none between two calls, so whatever got
+    // retired up to now is unreachable.
+    void reclaim()
+    {
+        if (!hasRetired_.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        std::vector<const HandlerList*> retired;
+        {
+            std::scoped_lock lk(writeMtx_);
+            retired.swap(retired_);
+            hasRetired_.store(false, std::memory_order_relaxed);
+        }
+        for (const auto* list : retired)
+        {
+            delete list;
+        }
+    }
+
+    using NodePool = SlabPool<sizeof(Node), alignof(Node)>;
+
+    NodePool nodes_;
+    // producers swing head_, the consumer owns tail_ (the stub whose event is already consumed)
+    std::atomic<Node*> head_{ nullptr };
+    Node* tail_ = ::new (nodes_.allocate()) Node();
+    std::atomic_flag consuming_;
+    std::atomic_bool coalesce_{ true };
+
+    std::atomic<const HandlerList*> handlers_{ nullptr };
+    // handlers_->threadSafe for anyone but the consumer
+    std::atomic_bool threadSafe_{ false };
+    std::mutex writeMtx_; // only taken by addHandler() and reclaim()
+    std::vector<const HandlerList*> retired_;
+    std::atomic_bool hasRetired_{ false };
+};
+
+template <typename... Ts>
+inline constexpr bool distinctTypes = true;
+
+template <typename T, typename... Rest>
+inline constexpr bool distinctTypes<T, Rest...> = (!std::is_same_v<T, Rest> && ...) && distinctTypes<Rest...>;
+} // namespace detail
+
+// Event types that are not part of an EventManager's static set, resolved at runtime through a type id. Lock-free
+// once a type has been seen; this is also what plugins register their own event types with.
+class DynamicEvents
+{
     struct TypeErased
     {
         virtual ~TypeErased()  = default;
@@ -57,7 +303,7 @@ class EventManager
     template <typename TEvent>
     struct TypedEventData : TypeErased
     {
-        EventData<TEvent> data;
+        detail::EventQueue<TEvent> data;
 
         void process() override
         {
@@ -65,24 +311,40 @@ class EventManager
         }
     };
 
+    using Slot = std::atomic<TypeErased*>;
+
+    // Slots come in chunks that never move, chunk k holds FirstChunk << k of them. Lookups stay lock-free while
+    // chunks are added, and ChunkCount of them hold more type ids than a program can use.
+    static constexpr size_t FirstChunk = 64;
+    static constexpr size_t ChunkCount = 32;
+
 public:
-    EventManager() = default;
+    DynamicEvents() = default;
 
-    template <typename TEvent>
-    void pushEvent(const TEvent& e)
+    ~DynamicEvents()
     {
-        auto* p = getOrCreate<TEvent>();
-        p->data.enqueue(e);
+        for (size_t chunk = 0; chunk < ChunkCount; ++chunk)
+        {
+            Slot* slots = chunks_[chunk].load(std::memory_order_relaxed);
+            if (!slots)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < FirstChunk << chunk; ++i)
+            {
+                delete slots[i].load(std::memory_order_relaxed);
+            }
+            delete[] slots;
+        }
     }
 
+    DynamicEvents(const DynamicEvents&)            = delete;
+    DynamicEvents& operator=(const DynamicEvents&) = delete;
+
     template <typename TEvent>
-    void registerEvent(std::function<bool(const TEvent&)>&& func)
+    detail::EventQueue<TEvent>& queue()
     {
-        auto* p = getOrCreate<TEvent>();
-        {
-            std::scoped_lock lk(p->data.mtx);
-            p->data.handlers.push_back(std::move(func));
-        }
+        return getOrCreate<TEvent>()->data;
     }
 
     void processAll();
@@ -103,25 +365,396 @@ private:
         return counter.fetch_add(1, std::memory_order_relaxed);
     }
 
+    // chunk and position in it of the slot for `id`
+    static std::pair<size_t, size_t> locate(TypeID id)
+    {
+        const size_t chunk = static_cast<size_t>(std::bit_width(id / FirstChunk + 1)) - 1;
+        return { chunk, id - FirstChunk * ((size_t{ 1 } << chunk) - 1) };
+    }
+
+    // lock-free once the type exists, creation is serialized on createMutex_
     template <typename TEvent>
     TypedEventData<TEvent>* getOrCreate()
     {
-        const auto id = getTypeID<TEvent>();
-        std::scoped_lock lk(mapMutex_);
-        auto it = map_.find(id);
-        if (it == map_.end())
+        const auto id              = getTypeID<TEvent>();
+        const auto [chunk, offset] = locate(id);
+        if (Slot* slots = chunks_[chunk].load(std::memory_order_acquire))
+        {
+            if (auto* p = slots[offset].load(std::memory_order_acquire))
+            {
+                return static_cast<TypedEventData<TEvent>*>(p);
+            }
+        }
+
+        std::scoped_lock lk(createMutex_);
+        Slot* slots = chunks_[chunk].load(std::memory_order_relaxed);
+        if (!slots)
+        {
+            slots = new Slot[FirstChunk << chunk]();
+            chunks_[chunk].store(slots, std::memory_order_release);
+        }
+        if (auto* p = slots[offset].load(std::memory_order_relaxed))
         {
-            auto up   = std::make_unique<TypedEventData<TEvent>>();
-            auto* ptr = up.get();
-            map_.emplace(id, std::move(up));
-            return ptr;
+            return static_cast<TypedEventData<TEvent>*>(p);
         }
-        return static_cast<TypedEventData<TEvent>*>(it->second.get());
+        auto* ptr = new TypedEventData<TEvent>();
+        slots[offset].store(ptr, std::memory_order_release);
+        if (id >= slotCount_.load(std::memory_order_relaxed))
+        {
+            slotCount_.store(id + 1, std::memory_order_release);
+        }
+        return ptr;
     }
 
 private:
-    std::mutex mapMutex_; // 仅保护 map_ 的增删查
-    HashMap<TypeID, std::unique_ptr<TypeErased>> map_;
+    std::mutex createMutex_;
+    // slot table indexed by TypeID (see locate()), null for chunks and types this manager hasn't seen
+    std::array<std::atomic<Slot*>, ChunkCount> chunks_{};
+    // one past the highest used TypeID
+    std::atomic<size_t> slotCount_{ 0 };
+};
+
+// Events... is the static event set: their queues live in a std::tuple and are reached without any lookup or
+// virtual call, processAll() visits them in the listed order. Any other type still works through DynamicEvents,
+// e.g. for plugins. An empty set (ana::EventManager em{}) is fully dynamic.
+//
+// processAll(pool) dispatches the static types whose handlers are all ThreadSafe as parallel tasks. orderBefore()
+// declares types that must stay sequential:
+//
+//   em.registerEvent<PathRequest>(findPath, ana::HandlerThreading::ThreadSafe);
+//   em.registerEvent<AIEvent>(think, ana::HandlerThreading::ThreadSafe);
+//   em.orderBefore<PathRequest, AIEvent>();
+//   em.processAll(pool);
+template <typename... Events>
+class EventManager
+{
+    template <typename TEvent>
+    static constexpr bool isStatic = (std::is_same_v<TEvent, Events> || ...);
+
+    static_assert(detail::distinctTypes<Events...>, "an event type is listed twice");
+
+    static constexpr size_t StaticCount = sizeof...(Events);
+
+    // position of TEvent in Events...
+    template <typename TEvent>
+    static constexpr size_t indexOf()
+    {
+        size_t i = 0;
+        ((!std::is_same_v<TEvent, Events> && (++i, true)) && ...);
+        return i;
+    }
+
+public:
+    EventManager()
+    {
+        for (size_t i = 0; i < StaticCount; ++i)
+        {
+            order_[i] = i;
+        }
+    }
+
+    EventManager(const EventManager&)            = delete;
+    EventManager& operator=(const EventManager&) = delete;
+
+    template <typename TEvent>
+    void pushEvent(const TEvent& e)
+    {
+        queue<TEvent>().enqueue(e);
+    }
+
+    // A type takes part in processAll(pool) only while all its handlers are ThreadSafe. Types outside the static
+    // set are always handled on the calling thread.
+    template <typename TEvent>
+    void registerEvent(std::function<bool(const TEvent&)>&& func,
+                       HandlerThreading threading = HandlerThreading::CallerOnly)
+    {
+        queue<TEvent>().addHandler(std::move(func), threading);
+    }
+
+    // merge queued TEvents per EventCoalescing<TEvent> before dispatch, on by default
+    template <typename TEvent>
+    void setCoalescing(bool enabled)
+    {
+        queue<TEvent>().setCoalescing(enabled);
+    }
+
+    // Before's handlers are done with this round's events before After's get theirs, in both processAll()s. Both
+    // have to be in the static set. Throws std::invalid_argument if that closes a cycle. Setup only: not while
+    // processAll() runs.
+    template <typename Before, typename After>
+    void orderBefore()
+    {
+        static_assert(isStatic<Before> && isStatic<After>, "only types of the static set can be ordered");
+        static_assert(!std::is_same_v<Before, After>, "a type can't be ordered before itself");
+        constexpr size_t from = indexOf<Before>();
+        constexpr size_t to   = indexOf<After>();
+        if (reaches(to, from))
+        {
+            throw std::invalid_argument("EventManager: ordering cycle");
+        }
+        before_[from].set(to);
+        sortOrder();
+        planned_ = false;
+    }
+
+    void processAll()
+    {
+        for (size_t index : order_)
+        {
+            processStatic(index);
+        }
+        dynamic_.processAll();
+    }
+
+    // Static types whose handlers are all ThreadSafe run as tasks on `pool`, as many at a time as the declared order
+    // allows. The other types run on the calling thread: ahead of the pool tasks if one of those is ordered after
+    // them, behind them if they are ordered after one, otherwise while the tasks run. Events of one type are still
+    // handled one at a time and in order. Returns when everything is handled, so don't call it from a worker of
+    // `pool`.
+    template <typename Pool>
+    void processAll(Pool& pool)
+    {
+        const auto safe = threadSafeTypes();
+        if (safe.none())
+        {
+            processAll();
+            return;
+        }
+        if (!planned_ || safe != plannedSafe_)
+        {
+            plan(safe);
+        }
+
+        for (size_t index : beforePool_)
+        {
+            processStatic(index);
+        }
+        graph_.run(pool);
+        try
+        {
+            for (size_t index : besidePool_)
+            {
+                processStatic(index);
+            }
+        }
+        catch (...)
+        {
+            // the tasks use this manager, they have to be done before the exception leaves
+            try
+            {
+                graph_.wait();
+            }
+            catch (...)
+            {
+            }
+            throw;
+        }
+        graph_.wait();
+        for (size_t index : afterPool_)
+        {
+            processStatic(index);
+        }
+        dynamic_.processAll();
+    }
+
+private:
+    using Types = std::bitset<StaticCount>;
+
+    template <typename TEvent>
+    detail::EventQueue<TEvent>& queue()
+    {
+        if constexpr (isStatic<TEvent>)
+        {
+            return std::get<detail::EventQueue<TEvent>>(static_);
+        }
+        else
+        {
+            return dynamic_.queue<TEvent>();
+        }
+    }
+
+    // fn(queue) for the static queue at `index`
+    template <typename Fn>
+    void visitStatic(size_t index, Fn&& fn)
+    {
+        std::apply(
+            [&](auto&... queues)
+            {
+                size_t i = 0;
+                ((i++ == index ? fn(queues) : void()), ...);
+            },
+            static_);
+    }
+
+    void processStatic(size_t index)
+    {
+        visitStatic(index,
+                    [](auto& queue)
+                    {
+                        queue.processSnapshot();
+                    });
+    }
+
+    Types threadSafeTypes() const
+    {
+        Types safe;
+        std::apply(
+            [&](const auto&... queues)
+            {
+                size_t i = 0;
+                (safe.set(i++, queues.threadSafe()), ...);
+            },
+            static_);
+        return safe;
+    }
+
+    // is there an ordering path from -> ... -> to
+    bool reaches(size_t from, size_t to) const
+    {
+        Types seen;
+        std::vector<size_t> stack{ from };
+        while (!stack.empty())
+        {
+            const size_t at = stack.back();
+            stack.pop_back();
+            if (at == to)
+            {
+                return true;
+            }
+            for (size_t next = 0; next < StaticCount; ++next)
+            {
+                if (before_[at].test(next) && !seen.test(next))
+                {
+                    seen.set(next);
+                    stack.push_back(next);
+                }
+            }
+        }
+        return false;
+    }
+
+    // topological order of the static types, ties in listed order
+    void sortOrder()
+    {
+        Types placed;
+        for (size_t slot = 0; slot < StaticCount; ++slot)
+        {
+            for (size_t candidate = 0; candidate < StaticCount; ++candidate)
+            {
+                bool ready = !placed.test(candidate);
+                for (size_t pred = 0; ready && pred < StaticCount; ++pred)
+                {
+                    ready = placed.test(pred) || !before_[pred].test(candidate);
+                }
+                if (ready)
+                {
+                    order_[slot] = candidate;
+                    placed.set(candidate);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Split the static types for processAll(pool). Rebuilt when the order or the set of ThreadSafe types changes.
+    void plan(const Types& safe)
+    {
+        enum class Phase
+        {
+            BeforePool,
+            Pool,
+            AfterPool
+        };
+        std::array<Phase, StaticCount> phase{};
+        std::array<TaskGraph::Task, StaticCount> tasks{};
+        graph_.clear();
+        beforePool_.clear();
+        besidePool_.clear();
+        afterPool_.clear();
+
+        // a type goes to the pool unless something ordered ahead of it runs after the pool, a caller type runs
+        // after the pool as soon as something ordered ahead of it doesn't run before it
+        for (size_t index : order_)
+        {
+            bool behindPool  = false;
+            bool behindAfter = false;
+            for (size_t pred = 0; pred < StaticCount; ++pred)
+            {
+                if (before_[pred].test(index))
+                {
+                    behindPool  = behindPool || phase[pred] == Phase::Pool;
+                    behindAfter = behindAfter || phase[pred] == Phase::AfterPool;
+                }
+            }
+            if (safe.test(index) && !behindAfter)
+            {
+                phase[index] = Phase::Pool;
+                tasks[index] = graph_.emplace(
+                    [this, index]
+                    {
+                        visitStatic(index,
+                                    [](auto& queue)
+                                    {
+                                        queue.processConcurrent();
+                                    });
+                    });
+                for (size_t pred = 0; pred < StaticCount; ++pred)
+                {
+                    if (before_[pred].test(index) && phase[pred] == Phase::Pool)
+                    {
+                        tasks[index].succeed(tasks[pred]);
+                    }
+                }
+            }
+            else
+            {
+                phase[index] = behindPool || behindAfter ? Phase::AfterPool : Phase::BeforePool;
+            }
+        }
+
+        // caller types with no pool task ordered after them (also not through other caller types) needn't hold the
+        // pool up and run while it works
+        Types feedsPool;
+        for (auto it = order_.rbegin(); it != order_.rend(); ++it)
+        {
+            const size_t index = *it;
+            for (size_t next = 0; next < StaticCount; ++next)
+            {
+                if (before_[index].test(next) && (phase[next] == Phase::Pool || feedsPool.test(next)))
+                {
+                    feedsPool.set(index);
+                }
+            }
+        }
+        for (size_t index : order_)
+        {
+            if (phase[index] == Phase::AfterPool)
+            {
+                afterPool_.push_back(index);
+            }
+            else if (phase[index] == Phase::BeforePool)
+            {
+                (feedsPool.test(index) ? beforePool_ : besidePool_).push_back(index);
+            }
+        }
+        plannedSafe_ = safe;
+        planned_     = true;
+    }
+
+    std::tuple<detail::EventQueue<Events>...> static_;
+    DynamicEvents dynamic_;
+
+    // before_[a].test(b): a's handlers run before b's
+    std::array<Types, StaticCount> before_{};
+    std::array<size_t, StaticCount> order_{};
+
+    // processAll(pool) plan for the ThreadSafe types in plannedSafe_
+    bool planned_ = false;
+    Types plannedSafe_;
+    TaskGraph graph_;
+    std::vector<size_t> beforePool_;
+    std::vector<size_t> besidePool_;
+    std::vector<size_t> afterPool_;
 };
 
 } // namespace ana
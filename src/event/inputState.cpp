@@ -0,0 +1,42 @@
+#include "inputState.h"
+
+namespace ana
+{
+
+void InputState::setKey(Key key, KeyState state)
+{
+    // a repeat only says the key is still down
+    pending_.keys_.set(InputSnapshot::index(key), state != KeyState::Released);
+    pending_.newestInput_ = std::chrono::steady_clock::now();
+}
+
+void InputState::setMouseButton(MouseButton button, bool pressed)
+{
+    pending_.buttons_.set(InputSnapshot::index(button), pressed);
+    pending_.newestInput_ = std::chrono::steady_clock::now();
+}
+
+void InputState::moveMouse(float absX, float absY, float deltaX, float deltaY)
+{
+    pending_.mouseX_ = absX;
+    pending_.mouseY_ = absY;
+    pending_.deltaX_ += deltaX;
+    pending_.deltaY_ += deltaY;
+    pending_.newestInput_ = std::chrono::steady_clock::now();
+}
+
+void InputState::publish()
+{
+    const uint32_t back = 1 - front_.load(std::memory_order_relaxed);
+    buffers_[back]      = pending_;
+    front_.store(back, std::memory_order_release);
+
+    // held keys and the cursor carry over, edges and motion start again
+    pending_.keys_.clearEdges();
+    pending_.buttons_.clearEdges();
+    pending_.deltaX_      = 0.0f;
+    pending_.deltaY_      = 0.0f;
+    pending_.newestInput_ = {};
+}
+
+} // namespace ana
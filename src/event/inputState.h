@@ -0,0 +1,167 @@
+#pragma once
+
+#include "event/input.h"
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace ana
+{
+namespace detail
+{
+// held buttons plus the ones that went down or up since the previous snapshot
+template <size_t N>
+struct ButtonBits
+{
+    std::bitset<N> down;
+    std::bitset<N> pressed;
+    std::bitset<N> released;
+
+    void set(size_t i, bool isDown)
+    {
+        assert(i < N && "button out of range");
+        if (isDown && !down.test(i))
+        {
+            pressed.set(i);
+        }
+        else if (!isDown && down.test(i))
+        {
+            released.set(i);
+        }
+        down.set(i, isDown);
+    }
+
+    void clearEdges()
+    {
+        pressed.reset();
+        released.reset();
+    }
+};
+} // namespace detail
+
+// The input devices as of one InputState::publish(): what is held, what changed since the publish before and how
+// far the mouse moved in between.
+class InputSnapshot
+{
+public:
+    bool isDown(Key key) const
+    {
+        return keys_.down.test(index(key));
+    }
+
+    // went down since the previous snapshot, also if it was released again before this one
+    bool wasPressed(Key key) const
+    {
+        return keys_.pressed.test(index(key));
+    }
+
+    bool wasReleased(Key key) const
+    {
+        return keys_.released.test(index(key));
+    }
+
+    bool isDown(MouseButton button) const
+    {
+        return buttons_.down.test(index(button));
+    }
+
+    bool wasPressed(MouseButton button) const
+    {
+        return buttons_.pressed.test(index(button));
+    }
+
+    bool wasReleased(MouseButton button) const
+    {
+        return buttons_.released.test(index(button));
+    }
+
+    float mouseX() const
+    {
+        return mouseX_;
+    }
+
+    float mouseY() const
+    {
+        return mouseY_;
+    }
+
+    // cursor motion summed over everything since the previous snapshot
+    float mouseDeltaX() const
+    {
+        return deltaX_;
+    }
+
+    float mouseDeltaY() const
+    {
+        return deltaY_;
+    }
+
+    // when the newest input in this snapshot arrived, a default time_point if nothing happened since the last one
+    std::chrono::steady_clock::time_point newestInput() const
+    {
+        return newestInput_;
+    }
+
+private:
+    friend class InputState;
+
+    static constexpr size_t KeyCount    = static_cast<size_t>(Key::Count);
+    static constexpr size_t ButtonCount = static_cast<size_t>(MouseButton::Count);
+
+    static size_t index(Key key)
+    {
+        return static_cast<size_t>(key);
+    }
+
+    static size_t index(MouseButton button)
+    {
+        return static_cast<size_t>(button);
+    }
+
+    detail::ButtonBits<KeyCount> keys_;
+    detail::ButtonBits<ButtonCount> buttons_;
+    float mouseX_ = 0.0f;
+    float mouseY_ = 0.0f;
+    float deltaX_ = 0.0f;
+    float deltaY_ = 0.0f;
+    std::chrono::steady_clock::time_point newestInput_{};
+};
+
+// Polled input. The window system writes every key, button and cursor change straight in here while it polls,
+// publish() turns what piled up into the snapshot the frame reads: no event objects, handlers or locks on the way.
+// Double-buffered: publish() fills the back buffer and flips, so a snapshot stays untouched until the next
+// publish(). Writes and publish() belong to the polling thread, a reader on another thread has to be done with its
+// snapshot before the next publish().
+class InputState
+{
+public:
+    InputState() = default;
+
+    InputState(const InputState&)            = delete;
+    InputState& operator=(const InputState&) = delete;
+
+    // writer side, called by the window system
+    void setKey(Key key, KeyState state);
+    void setMouseButton(MouseButton button, bool pressed);
+    void moveMouse(float absX, float absY, float deltaX, float deltaY);
+
+    // hand out what was written since the last call as the new snapshot
+    void publish();
+
+    const InputSnapshot& snapshot() const
+    {
+        return buffers_[front_.load(std::memory_order_acquire)];
+    }
+
+private:
+    // written by the window system, copied out by publish()
+    InputSnapshot pending_;
+    std::array<InputSnapshot, 2> buffers_;
+    std::atomic<uint32_t> front_{ 0 };
+};
+
+} // namespace ana
@@ -6,6 +6,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "simd.h"
+#include <cassert>
+#include <span>
+
 namespace ana
 {
 // Vector Types
@@ -102,6 +106,33 @@ inline Vec3 CrossLH(const Vec3& a, const Vec3& b)
     return glm::cross(a, b);
 }
 
+// SIMD products (see math/simd.h), same results as glm's operator* up to rounding
+static_assert(sizeof(Mat4) == 16 * sizeof(float) && sizeof(Vec4) == 4 * sizeof(float), "glm types must be packed");
+
+inline Mat4 Mul(const Mat4& a, const Mat4& b)
+{
+    Mat4 result;
+    math::Mat4Mul(&a[0][0], &b[0][0], &result[0][0]);
+    return result;
+}
+
+inline Vec4 Mul(const Mat4& m, const Vec4& v)
+{
+    Vec4 result;
+    math::Mat4MulVec4(&m[0][0], &v[0], &result[0]);
+    return result;
+}
+
+// out[i] = a * b[i], out may be b
+inline void MulBatch(const Mat4& a, std::span<const Mat4> b, std::span<Mat4> out)
+{
+    assert(out.size() >= b.size() && "MulBatch: output too small");
+    if (!b.empty())
+    {
+        math::Mat4MulBatch(&a[0][0], &b[0][0][0], &out[0][0][0], b.size());
+    }
+}
+
 // Matrix transformations
 inline Mat4 Translate(const Mat4& m, const Vec3& v)
 {
@@ -0,0 +1,452 @@
+#include "simd.h"
+
+#include <atomic>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ANA_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define ANA_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// the AVX2 kernels are built for AVX2 + FMA while the rest of the file stays at the baseline
+#if defined(ANA_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ANA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define ANA_TARGET_AVX2
+#endif
+
+namespace ana::math
+{
+
+namespace
+{
+struct Kernels
+{
+    SimdLevel level;
+    void (*mat4Mul)(const float*, const float*, float*);
+    void (*mat4MulVec4)(const float*, const float*, float*);
+    void (*mat4MulBatch)(const float*, const float*, float*, std::size_t);
+    void (*transformPoints)(const float*, const float*, const float*, const float*, float*, float*, float*, float*,
+                            std::size_t);
+};
+
+// --- scalar ---------------------------------------------------------------------------------------------------
+
+void mat4MulScalar(const float* a, const float* b, float* out)
+{
+    float lhs[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        lhs[i] = a[i];
+    }
+    for (int col = 0; col < 4; ++col)
+    {
+        const float b0 = b[col * 4 + 0];
+        const float b1 = b[col * 4 + 1];
+        const float b2 = b[col * 4 + 2];
+        const float b3 = b[col * 4 + 3];
+        for (int row = 0; row < 4; ++row)
+        {
+            out[col * 4 + row] = lhs[row] * b0 + lhs[4 + row] * b1 + lhs[8 + row] * b2 + lhs[12 + row] * b3;
+        }
+    }
+}
+
+void mat4MulVec4Scalar(const float* m, const float* v, float* out)
+{
+    const float v0 = v[0];
+    const float v1 = v[1];
+    const float v2 = v[2];
+    const float v3 = v[3];
+    for (int row = 0; row < 4; ++row)
+    {
+        out[row] = m[row] * v0 + m[4 + row] * v1 + m[8 + row] * v2 + m[12 + row] * v3;
+    }
+}
+
+void mat4MulBatchScalar(const float* a, const float* b, float* out, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        mat4MulScalar(a, b + i * 16, out + i * 16);
+    }
+}
+
+void transformPointsScalar(const float* m, const float* x, const float* y, const float* z, float* outX, float* outY,
+                           float* outZ, float* outW, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const float px = x[i];
+        const float py = y[i];
+        const float pz = z[i];
+        outX[i]        = m[0] * px + m[4] * py + m[8] * pz + m[12];
+        outY[i]        = m[1] * px + m[5] * py + m[9] * pz + m[13];
+        outZ[i]        = m[2] * px + m[6] * py + m[10] * pz + m[14];
+        if (outW)
+        {
+            outW[i] = m[3] * px + m[7] * py + m[11] * pz + m[15];
+        }
+    }
+}
+
+constexpr Kernels ScalarKernels{ SimdLevel::Scalar, mat4MulScalar, mat4MulVec4Scalar, mat4MulBatchScalar,
+                                 transformPointsScalar };
+
+#if defined(ANA_SIMD_X86)
+// --- SSE ------------------------------------------------------------------------------------------------------
+
+template <int Lane>
+__m128 splat(__m128 v)
+{
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Lane, Lane, Lane, Lane));
+}
+
+// column = a * (b0, b1, b2, b3), a's columns in registers
+__m128 combineSSE(const __m128 (&a)[4], __m128 b)
+{
+    __m128 r = _mm_mul_ps(a[0], splat<0>(b));
+    r        = _mm_add_ps(r, _mm_mul_ps(a[1], splat<1>(b)));
+    r        = _mm_add_ps(r, _mm_mul_ps(a[2], splat<2>(b)));
+    return _mm_add_ps(r, _mm_mul_ps(a[3], splat<3>(b)));
+}
+
+void mat4MulBatchSSE(const float* a, const float* b, float* out, std::size_t count)
+{
+    const __m128 lhs[4] = { _mm_loadu_ps(a), _mm_loadu_ps(a + 4), _mm_loadu_ps(a + 8), _mm_loadu_ps(a + 12) };
+    for (std::size_t i = 0; i < count; ++i, b += 16, out += 16)
+    {
+        const __m128 b0 = _mm_loadu_ps(b);
+        const __m128 b1 = _mm_loadu_ps(b + 4);
+        const __m128 b2 = _mm_loadu_ps(b + 8);
+        const __m128 b3 = _mm_loadu_ps(b + 12);
+        _mm_storeu_ps(out, combineSSE(lhs, b0));
+        _mm_storeu_ps(out + 4, combineSSE(lhs, b1));
+        _mm_storeu_ps(out + 8, combineSSE(lhs, b2));
+        _mm_storeu_ps(out + 12, combineSSE(lhs, b3));
+    }
+}
+
+void mat4MulSSE(const float* a, const float* b, float* out)
+{
+    mat4MulBatchSSE(a, b, out, 1);
+}
+
+void mat4MulVec4SSE(const float* m, const float* v, float* out)
+{
+    const __m128 cols[4] = { _mm_loadu_ps(m), _mm_loadu_ps(m + 4), _mm_loadu_ps(m + 8), _mm_loadu_ps(m + 12) };
+    _mm_storeu_ps(out, combineSSE(cols, _mm_loadu_ps(v)));
+}
+
+void transformPointsSSE(const float* m, const float* x, const float* y, const float* z, float* outX, float* outY,
+                        float* outZ, float* outW, std::size_t count)
+{
+    __m128 mm[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        mm[i] = _mm_set1_ps(m[i]);
+    }
+    const auto row = [&](int r, __m128 px, __m128 py, __m128 pz)
+    {
+        __m128 v = _mm_add_ps(_mm_mul_ps(mm[r], px), mm[12 + r]);
+        v        = _mm_add_ps(v, _mm_mul_ps(mm[4 + r], py));
+        return _mm_add_ps(v, _mm_mul_ps(mm[8 + r], pz));
+    };
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        _mm_storeu_ps(outX + i, row(0, px, py, pz));
+        _mm_storeu_ps(outY + i, row(1, px, py, pz));
+        _mm_storeu_ps(outZ + i, row(2, px, py, pz));
+        if (outW)
+        {
+            _mm_storeu_ps(outW + i, row(3, px, py, pz));
+        }
+    }
+    transformPointsScalar(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, outW ? outW + i : nullptr, count - i);
+}
+
+constexpr Kernels SSEKernels{ SimdLevel::SSE, mat4MulSSE, mat4MulVec4SSE, mat4MulBatchSSE, transformPointsSSE };
+
+// --- AVX2 + FMA -----------------------------------------------------------------------------------------------
+
+// two result columns per register: the low lane from b's first column, the high lane from the second
+ANA_TARGET_AVX2 __m256 combineAVX2(const __m256 (&a)[4], __m256 b)
+{
+    __m256 r = _mm256_mul_ps(a[0], _mm256_permute_ps(b, _MM_SHUFFLE(0, 0, 0, 0)));
+    r        = _mm256_fmadd_ps(a[1], _mm256_permute_ps(b, _MM_SHUFFLE(1, 1, 1, 1)), r);
+    r        = _mm256_fmadd_ps(a[2], _mm256_permute_ps(b, _MM_SHUFFLE(2, 2, 2, 2)), r);
+    return _mm256_fmadd_ps(a[3], _mm256_permute_ps(b, _MM_SHUFFLE(3, 3, 3, 3)), r);
+}
+
+ANA_TARGET_AVX2 void mat4MulBatchAVX2(const float* a, const float* b, float* out, std::size_t count)
+{
+    // every column of a in both lanes
+    const __m256 lhs[4] = {
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12)),
+    };
+    for (std::size_t i = 0; i < count; ++i, b += 16, out += 16)
+    {
+        const __m256 b01 = _mm256_loadu_ps(b);
+        const __m256 b23 = _mm256_loadu_ps(b + 8);
+        _mm256_storeu_ps(out, combineAVX2(lhs, b01));
+        _mm256_storeu_ps(out + 8, combineAVX2(lhs, b23));
+    }
+}
+
+ANA_TARGET_AVX2 void mat4MulAVX2(const float* a, const float* b, float* out)
+{
+    mat4MulBatchAVX2(a, b, out, 1);
+}
+
+ANA_TARGET_AVX2 void transformPointsAVX2(const float* m, const float* x, const float* y, const float* z, float* outX,
+                                         float* outY, float* outZ, float* outW, std::size_t count)
+{
+    __m256 mm[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        mm[i] = _mm256_set1_ps(m[i]);
+    }
+    const auto row = [&](int r, __m256 px, __m256 py, __m256 pz) ANA_TARGET_AVX2
+    {
+        __m256 v = _mm256_fmadd_ps(mm[r], px, mm[12 + r]);
+        v        = _mm256_fmadd_ps(mm[4 + r], py, v);
+        return _mm256_fmadd_ps(mm[8 + r], pz, v);
+    };
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 px = _mm256_loadu_ps(x + i);
+        const __m256 py = _mm256_loadu_ps(y + i);
+        const __m256 pz = _mm256_loadu_ps(z + i);
+        _mm256_storeu_ps(outX + i, row(0, px, py, pz));
+        _mm256_storeu_ps(outY + i, row(1, px, py, pz));
+        _mm256_storeu_ps(outZ + i, row(2, px, py, pz));
+        if (outW)
+        {
+            _mm256_storeu_ps(outW + i, row(3, px, py, pz));
+        }
+    }
+    transformPointsSSE(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, outW ? outW + i : nullptr, count - i);
+}
+
+// a single mat4 * vec4 is one register wide, the SSE kernel is as good as it gets
+constexpr Kernels AVX2Kernels{ SimdLevel::AVX2, mat4MulAVX2, mat4MulVec4SSE, mat4MulBatchAVX2, transformPointsAVX2 };
+
+bool cpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    const bool fma     = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    // also checks that the OS saves the ymm registers
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif // ANA_SIMD_X86
+
+#if defined(ANA_SIMD_NEON)
+// --- NEON -----------------------------------------------------------------------------------------------------
+
+float32x4_t combineNEON(const float32x4_t (&a)[4], float32x4_t b)
+{
+    float32x4_t r = vmulq_laneq_f32(a[0], b, 0);
+    r             = vfmaq_laneq_f32(r, a[1], b, 1);
+    r             = vfmaq_laneq_f32(r, a[2], b, 2);
+    return vfmaq_laneq_f32(r, a[3], b, 3);
+}
+
+void mat4MulBatchNEON(const float* a, const float* b, float* out, std::size_t count)
+{
+    const float32x4_t lhs[4] = { vld1q_f32(a), vld1q_f32(a + 4), vld1q_f32(a + 8), vld1q_f32(a + 12) };
+    for (std::size_t i = 0; i < count; ++i, b += 16, out += 16)
+    {
+        const float32x4_t b0 = vld1q_f32(b);
+        const float32x4_t b1 = vld1q_f32(b + 4);
+        const float32x4_t b2 = vld1q_f32(b + 8);
+        const float32x4_t b3 = vld1q_f32(b + 12);
+        vst1q_f32(out, combineNEON(lhs, b0));
+        vst1q_f32(out + 4, combineNEON(lhs, b1));
+        vst1q_f32(out + 8, combineNEON(lhs, b2));
+        vst1q_f32(out + 12, combineNEON(lhs, b3));
+    }
+}
+
+void mat4MulNEON(const float* a, const float* b, float* out)
+{
+    mat4MulBatchNEON(a, b, out, 1);
+}
+
+void mat4MulVec4NEON(const float* m, const float* v, float* out)
+{
+    const float32x4_t cols[4] = { vld1q_f32(m), vld1q_f32(m + 4), vld1q_f32(m + 8), vld1q_f32(m + 12) };
+    vst1q_f32(out, combineNEON(cols, vld1q_f32(v)));
+}
+
+void transformPointsNEON(const float* m, const float* x, const float* y, const float* z, float* outX, float* outY,
+                         float* outZ, float* outW, std::size_t count)
+{
+    const auto row = [&](int r, float32x4_t px, float32x4_t py, float32x4_t pz)
+    {
+        float32x4_t v = vfmaq_n_f32(vdupq_n_f32(m[12 + r]), px, m[r]);
+        v             = vfmaq_n_f32(v, py, m[4 + r]);
+        return vfmaq_n_f32(v, pz, m[8 + r]);
+    };
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const float32x4_t px = vld1q_f32(x + i);
+        const float32x4_t py = vld1q_f32(y + i);
+        const float32x4_t pz = vld1q_f32(z + i);
+        vst1q_f32(outX + i, row(0, px, py, pz));
+        vst1q_f32(outY + i, row(1, px, py, pz));
+        vst1q_f32(outZ + i, row(2, px, py, pz));
+        if (outW)
+        {
+            vst1q_f32(outW + i, row(3, px, py, pz));
+        }
+    }
+    transformPointsScalar(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, outW ? outW + i : nullptr, count - i);
+}
+
+constexpr Kernels NEONKernels{ SimdLevel::NEON, mat4MulNEON, mat4MulVec4NEON, mat4MulBatchNEON,
+                               transformPointsNEON };
+#endif // ANA_SIMD_NEON
+
+// --- dispatch -------------------------------------------------------------------------------------------------
+
+const Kernels* kernelsFor(SimdLevel level)
+{
+    switch (level)
+    {
+#if defined(ANA_SIMD_X86)
+    case SimdLevel::SSE:
+        return &SSEKernels;
+    case SimdLevel::AVX2:
+        return cpuHasAVX2() ? &AVX2Kernels : nullptr;
+#endif
+#if defined(ANA_SIMD_NEON)
+    case SimdLevel::NEON:
+        return &NEONKernels;
+#endif
+    case SimdLevel::Scalar:
+        return &ScalarKernels;
+    default:
+        return nullptr;
+    }
+}
+
+const Kernels* detectedKernels()
+{
+    static const Kernels* const s_detected = []
+    {
+        for (SimdLevel level : { SimdLevel::AVX2, SimdLevel::NEON, SimdLevel::SSE })
+        {
+            if (const Kernels* kernels = kernelsFor(level))
+            {
+                return kernels;
+            }
+        }
+        return &ScalarKernels;
+    }();
+    return s_detected;
+}
+
+// null until the first call or SetSimdLevel()
+std::atomic<const Kernels*> s_active{ nullptr };
+
+const Kernels& active()
+{
+    const Kernels* kernels = s_active.load(std::memory_order_acquire);
+    if (!kernels)
+    {
+        kernels = detectedKernels();
+        s_active.store(kernels, std::memory_order_release);
+    }
+    return *kernels;
+}
+} // namespace
+
+SimdLevel DetectedSimdLevel()
+{
+    return detectedKernels()->level;
+}
+
+SimdLevel ActiveSimdLevel()
+{
+    return active().level;
+}
+
+SimdLevel SetSimdLevel(SimdLevel level)
+{
+    const Kernels* kernels = kernelsFor(level);
+    if (!kernels)
+    {
+        kernels = detectedKernels();
+    }
+    s_active.store(kernels, std::memory_order_release);
+    return kernels->level;
+}
+
+std::string_view ToString(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return "Scalar";
+    case SimdLevel::SSE:
+        return "SSE";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::NEON:
+        return "NEON";
+    }
+    return "Unknown";
+}
+
+void Mat4Mul(const float* a, const float* b, float* out)
+{
+    active().mat4Mul(a, b, out);
+}
+
+void Mat4MulVec4(const float* m, const float* v, float* out)
+{
+    active().mat4MulVec4(m, v, out);
+}
+
+void Mat4MulBatch(const float* a, const float* b, float* out, std::size_t count)
+{
+    active().mat4MulBatch(a, b, out, count);
+}
+
+void TransformPointsSoA(const float* m, const float* x, const float* y, const float* z, float* outX, float* outY,
+                        float* outZ, float* outW, std::size_t count)
+{
+    active().transformPoints(m, x, y, z, outX, outY, outZ, outW, count);
+}
+
+} // namespace ana::math
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Matrix kernels on plain floats. A matrix is 16 floats in glm's column-major layout (m[col * 4 + row]), nothing
+// needs to be aligned and an output may be one of the inputs. Each call goes to the widest kernel set the CPU
+// supports, picked once at runtime; math.h wraps them for the glm types.
+namespace ana::math
+{
+enum class SimdLevel
+{
+    Scalar,
+    // x86-64 baseline
+    SSE,
+    // AVX2 + FMA
+    AVX2,
+    // AArch64 Advanced SIMD
+    NEON
+};
+
+// the widest level this CPU runs
+SimdLevel DetectedSimdLevel();
+// the level the kernels use, DetectedSimdLevel() unless SetSimdLevel() says otherwise
+SimdLevel ActiveSimdLevel();
+// Pin the kernels to `level`, e.g. to compare them in a benchmark. A level the CPU can't run falls back to the
+// detected one; returns the level now in use.
+SimdLevel SetSimdLevel(SimdLevel level);
+std::string_view ToString(SimdLevel level);
+
+// out = a * b
+void Mat4Mul(const float* a, const float* b, float* out);
+// out = m * v
+void Mat4MulVec4(const float* m, const float* v, float* out);
+// out[i] = a * b[i] for `count` matrices stored back to back
+void Mat4MulBatch(const float* a, const float* b, float* out, std::size_t count);
+// (x[i], y[i], z[i], 1) through m for `count` points in SoA arrays, outW may be null for affine m
+void TransformPointsSoA(const float* m, const float* x, const float* y, const float* z, float* outX, float* outY,
+                        float* outZ, float* outW, std::size_t count);
+} // namespace ana::math
@@ -70,14 +70,25 @@ void RenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<
                                      Camera& camera)
 {
     anaPipeline->bind(commandBuffer);
+
+    // projection * view once per frame, then all models in one batch
+    modelMatrices.clear();
     for (auto& obj : gameObjects)
     {
         // obj.transform.rotation.y = glm::mod(obj.transform.rotation.y + 0.01f, glm::two_pi<float>());
         // obj.transform.rotation.x = glm::mod(obj.transform.rotation.x + 0.005f, glm::two_pi<float>());
+        modelMatrices.push_back(obj.transform.mat4());
+    }
+    mvpMatrices.resize(modelMatrices.size());
+    MulBatch(Mul(camera.getProjection(), camera.getView()), modelMatrices, mvpMatrices);
+
+    for (size_t i = 0; i < gameObjects.size(); ++i)
+    {
+        auto& obj = gameObjects[i];
         SimplePushConstantData push{};
 
         push.color     = obj.color;
-        push.transform = camera.getProjection() * camera.getView() * obj.transform.mat4();
+        push.transform = mvpMatrices[i];
 
         vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
                            sizeof(SimplePushConstantData), &push);
@@ -28,5 +28,9 @@ private:
     vk::Device& device;
     std::unique_ptr<vk::ANAPipeline> anaPipeline;
     VkPipelineLayout pipelineLayout;
+
+    // per frame, kept to reuse the storage
+    std::vector<Mat4> modelMatrices;
+    std::vector<Mat4> mvpMatrices;
 };
 } // namespace ana
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string_view>
 
 #define BACKWARD_HAS_DW 1
 #include "backward.hpp"
@@ -14,9 +15,24 @@ backward::SignalHandling sh;
 
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    ana::APP app{};
+    ana::AppOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if ((arg == "--record" || arg == "--replay") && i + 1 < argc)
+        {
+            (arg == "--record" ? options.recordInput : options.replayInput) = argv[++i];
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--record <input log> | --replay <input log>]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    ana::APP app{ options };
 
     try
     {
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace ana
+{
+
+// Hint to the core that we are busy-waiting (PAUSE on x86, YIELD on ARM).
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Exponential backoff for spin loops: doubles the number of pause instructions per round up to a cap.
+class Backoff
+{
+public:
+    static constexpr std::uint32_t MaxPauses = 16;
+
+    void pause()
+    {
+        for (std::uint32_t i = 0; i < m_pauses; ++i)
+        {
+            cpuRelax();
+        }
+        if (m_pauses < MaxPauses)
+        {
+            m_pauses <<= 1;
+        }
+    }
+
+    void reset()
+    {
+        m_pauses = 1;
+    }
+
+private:
+    std::uint32_t m_pauses = 1;
+};
+
+} // namespace ana
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <concepts>
+#include <functional>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+namespace ana
+{
+
+// Stop source shared by a group of tasks, e.g. all streaming and culling jobs issued for one camera position.
+// Tasks are enqueued with group.token(); after cancel() the ones that haven't started yet are dropped without
+// running and the running ones see stop_requested() on their token.
+//
+//   pool.submit(streaming.token(), [](std::stop_token stop) { ... });
+//   streaming.renew(); // camera teleported
+class CancellationGroup
+{
+public:
+    [[nodiscard]] std::stop_token token() const
+    {
+        return m_source.get_token();
+    }
+
+    // returns false if the group was already cancelled
+    bool cancel()
+    {
+        return m_source.request_stop();
+    }
+
+    [[nodiscard]] bool cancelled() const
+    {
+        return m_source.stop_requested();
+    }
+
+    // cancel everything issued so far and start a fresh generation for the tasks enqueued from now on. Not safe
+    // to call concurrently with token().
+    void renew()
+    {
+        m_source.request_stop();
+        m_source = std::stop_source();
+    }
+
+private:
+    std::stop_source m_source;
+};
+
+namespace threads
+{
+// call `func` with `token` prepended if it accepts one, like std::jthread does
+template <typename Function, typename... Args>
+decltype(auto) invokeWithToken(Function& func, const std::stop_token& token, Args&... args)
+{
+    if constexpr (std::invocable<Function&, std::stop_token, Args&...>)
+    {
+        return std::invoke(func, token, args...);
+    }
+    else
+    {
+        return std::invoke(func, args...);
+    }
+}
+
+template <typename Function, typename... Args>
+concept StoppableTask = std::invocable<Function&, std::stop_token, Args&...> || std::invocable<Function&, Args&...>;
+
+// what invokeWithToken() returns, without a `type` for a non-invocable Function so overloads can SFINAE on it
+template <typename Function, typename... Args>
+struct StoppableResultOf : std::invoke_result<Function&, Args&...>
+{
+};
+
+template <typename Function, typename... Args>
+    requires std::invocable<Function&, std::stop_token, Args&...>
+struct StoppableResultOf<Function, Args...> : std::invoke_result<Function&, std::stop_token, Args&...>
+{
+};
+
+template <typename Function, typename... Args>
+using StoppableResult = typename StoppableResultOf<Function, Args...>::type;
+} // namespace threads
+
+} // namespace ana
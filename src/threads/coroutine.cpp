@@ -0,0 +1,91 @@
+#include "coroutine.h"
+
+#include <algorithm>
+#include <new>
+
+#include "slabPool.h"
+
+namespace ana
+{
+
+namespace
+{
+// frame size classes, anything bigger goes to the global heap
+constexpr std::size_t SmallFrame  = 256;
+constexpr std::size_t MediumFrame = 1024;
+constexpr std::size_t LargeFrame  = 4096;
+
+template <std::size_t Size>
+SlabPool<Size>& framePool()
+{
+    static SlabPool<Size> s_pool;
+    return s_pool;
+}
+} // namespace
+
+void* threads::allocateFrame(std::size_t size)
+{
+    if (size <= SmallFrame)
+    {
+        return framePool<SmallFrame>().allocate();
+    }
+    if (size <= MediumFrame)
+    {
+        return framePool<MediumFrame>().allocate();
+    }
+    if (size <= LargeFrame)
+    {
+        return framePool<LargeFrame>().allocate();
+    }
+    return ::operator new(size);
+}
+
+void threads::deallocateFrame(void* frame, std::size_t size) noexcept
+{
+    if (size <= SmallFrame)
+    {
+        framePool<SmallFrame>().deallocate(frame);
+    }
+    else if (size <= MediumFrame)
+    {
+        framePool<MediumFrame>().deallocate(frame);
+    }
+    else if (size <= LargeFrame)
+    {
+        framePool<LargeFrame>().deallocate(frame);
+    }
+    else
+    {
+        ::operator delete(frame, size);
+    }
+}
+
+std::size_t CompletionPoller::poll()
+{
+    std::scoped_lock lk(m_mutex);
+    return std::erase_if(m_waiters,
+                         [](Waiter* waiter)
+                         {
+                             if (!waiter->ready(waiter))
+                             {
+                                 return false;
+                             }
+                             // the coroutine may already be running again, the waiter is gone after this
+                             waiter->resume(waiter);
+                             return true;
+                         });
+}
+
+std::size_t CompletionPoller::pending() const
+{
+    std::scoped_lock lk(m_mutex);
+    return m_waiters.size();
+}
+
+void CompletionPoller::add(Waiter* waiter)
+{
+    std::scoped_lock lk(m_mutex);
+    m_waiters.push_back(waiter);
+}
+
+} // namespace ana
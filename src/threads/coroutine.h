@@ -0,0 +1,723 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <latch>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace ana
+{
+
+template <typename T = void>
+class CoTask;
+
+namespace threads
+{
+// Coroutine frames come from size-class slab pools (see coroutine.cpp), bigger frames fall back to the heap.
+void* allocateFrame(std::size_t size);
+void deallocateFrame(void* frame, std::size_t size) noexcept;
+
+template <typename T>
+using CoResult = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+// Outcome of one awaited task, filled in by the task itself and read by whoever joins it.
+template <typename T>
+struct CoSlot
+{
+    std::optional<CoResult<T>> value;
+    std::exception_ptr error;
+
+    CoResult<T> take()
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+struct PooledFrame
+{
+    static void* operator new(std::size_t size)
+    {
+        return allocateFrame(size);
+    }
+
+    static void operator delete(void* frame, std::size_t size) noexcept
+    {
+        deallocateFrame(frame, size);
+    }
+};
+
+class CoPromiseBase : public PooledFrame
+{
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        // symmetric transfer to whoever awaited us, so long chains don't grow the stack
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> self) noexcept
+        {
+            if (auto continuation = self.promise().m_continuation)
+            {
+                return continuation;
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+public:
+    // tasks are lazy and start when awaited
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        m_error = std::current_exception();
+    }
+
+    void setContinuation(std::coroutine_handle<> continuation) noexcept
+    {
+        m_continuation = continuation;
+    }
+
+protected:
+    std::coroutine_handle<> m_continuation;
+    std::exception_ptr m_error;
+};
+
+template <typename T>
+class CoPromise : public CoPromiseBase
+{
+public:
+    CoTask<T> get_return_object() noexcept;
+
+    template <typename Value>
+        requires std::is_convertible_v<Value&&, T>
+    void return_value(Value&& value)
+    {
+        m_value.emplace(std::forward<Value>(value));
+    }
+
+    T result()
+    {
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+        return std::move(*m_value);
+    }
+
+private:
+    std::optional<T> m_value;
+};
+
+template <>
+class CoPromise<void> : public CoPromiseBase
+{
+public:
+    CoTask<void> get_return_object() noexcept;
+
+    void return_void() const noexcept
+    {
+    }
+
+    void result()
+    {
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+};
+
+// Countdown that resumes one awaiting coroutine (or releases one blocked thread) after `count` arrivals.
+// The counter starts at count + 1 so that the awaiter's own decrement decides who is last: if every member
+// already arrived the awaiter simply doesn't suspend.
+class CoLatch
+{
+public:
+    explicit CoLatch(std::size_t count)
+        : m_count(count + 1)
+    {
+    }
+
+    CoLatch(const CoLatch&)            = delete;
+    CoLatch& operator=(const CoLatch&) = delete;
+
+    // called by a finished member, returns the coroutine to transfer to
+    std::coroutine_handle<> arrive() noexcept
+    {
+        if (m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            if (m_blocked)
+            {
+                m_blocked->count_down();
+                return std::noop_coroutine();
+            }
+            return m_awaiter;
+        }
+        return std::noop_coroutine();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return m_count.load(std::memory_order_acquire) == 1;
+    }
+
+    bool await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        m_awaiter = awaiter;
+        return m_count.fetch_sub(1, std::memory_order_acq_rel) > 1;
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+    // blocking counterpart of co_await for threads outside the pool
+    void wait()
+    {
+        std::latch done{ 1 };
+        m_blocked = &done;
+        if (m_count.fetch_sub(1, std::memory_order_acq_rel) > 1)
+        {
+            done.wait();
+        }
+    }
+
+private:
+    std::atomic<std::size_t> m_count;
+    std::coroutine_handle<> m_awaiter;
+    std::latch* m_blocked = nullptr;
+};
+
+// Coroutine that runs one task to completion, stores its outcome and arrives at a CoLatch. The frame stays
+// suspended at its end until the owner destroys it.
+class JoinMember
+{
+public:
+    struct promise_type : PooledFrame
+    {
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept
+            {
+                // the frame may be destroyed as soon as we arrived, don't touch it afterwards
+                return self.promise().latch->arrive();
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        JoinMember get_return_object() noexcept
+        {
+            return JoinMember{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        FinalAwaiter final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept
+        {
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            // the body catches everything
+        }
+
+        CoLatch* latch = nullptr;
+    };
+
+    JoinMember() = default;
+
+    explicit JoinMember(std::coroutine_handle<promise_type> handle)
+        : m_handle(handle)
+    {
+    }
+
+    JoinMember(JoinMember&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr))
+    {
+    }
+
+    JoinMember& operator=(JoinMember&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~JoinMember()
+    {
+        reset();
+    }
+
+    std::coroutine_handle<> start(CoLatch& latch) noexcept
+    {
+        m_handle.promise().latch = &latch;
+        return m_handle;
+    }
+
+private:
+    void reset()
+    {
+        if (m_handle)
+        {
+            std::exchange(m_handle, nullptr).destroy();
+        }
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template <typename T>
+JoinMember makeJoinMember(CoTask<T> task, CoSlot<T>& slot)
+{
+    try
+    {
+        if constexpr (std::is_void_v<T>)
+        {
+            co_await std::move(task);
+            slot.value.emplace();
+        }
+        else
+        {
+            slot.value.emplace(co_await std::move(task));
+        }
+    }
+    catch (...)
+    {
+        slot.error = std::current_exception();
+    }
+}
+
+// Fire-and-forget coroutine, cleans up after itself. The first parameter is the pool it runs on, exceptions end up
+// in its exception handler like those of ThreadPool::enqueueDetach().
+struct DetachedCoroutine
+{
+    struct promise_type : PooledFrame
+    {
+        template <typename Pool, typename... Args>
+        explicit promise_type(Pool& pool, const Args&...) noexcept
+            : m_pool(&pool)
+            , m_report(
+                  [](void* target, std::exception_ptr error)
+                  {
+                      static_cast<Pool*>(target)->handleException(std::move(error));
+                  })
+        {
+        }
+
+        DetachedCoroutine get_return_object() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept
+        {
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            m_report(m_pool, std::current_exception());
+        }
+
+    private:
+        void* m_pool;
+        void (*m_report)(void*, std::exception_ptr);
+    };
+};
+
+// co_await pool.schedule() continues the coroutine on one of the pool's workers
+template <typename Pool, typename Priority>
+class ScheduleAwaiter
+{
+public:
+    ScheduleAwaiter(Pool& pool, Priority priority)
+        : m_pool(pool)
+        , m_priority(priority)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_pool.enqueueDetach(m_priority,
+                             [handle]
+                             {
+                                 handle.resume();
+                             });
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+private:
+    Pool& m_pool;
+    Priority m_priority;
+};
+} // namespace threads
+
+// Lazily started coroutine returning T. Awaiting a CoTask starts it on the awaiting thread and resumes the awaiter
+// right where the task finishes, no thread ever blocks in between:
+//
+//   ana::CoTask<Mesh> loadMesh(Pool& pool, std::string path)
+//   {
+//       co_await pool.schedule();
+//       auto [bytes, material] = co_await pool.whenAll(readFile(pool, path), loadMaterial(pool, path));
+//       co_return parseMesh(bytes, material);
+//   }
+template <typename T>
+class [[nodiscard]] CoTask
+{
+public:
+    using promise_type = threads::CoPromise<T>;
+    using Handle       = std::coroutine_handle<promise_type>;
+
+    CoTask() = default;
+
+    explicit CoTask(Handle handle)
+        : m_handle(handle)
+    {
+    }
+
+    CoTask(CoTask&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr))
+    {
+    }
+
+    CoTask& operator=(CoTask&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    CoTask(const CoTask&)            = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask()
+    {
+        reset();
+    }
+
+    [[nodiscard]] bool valid() const
+    {
+        return static_cast<bool>(m_handle);
+    }
+
+    [[nodiscard]] bool done() const
+    {
+        return m_handle && m_handle.done();
+    }
+
+    auto operator co_await() noexcept
+    {
+        struct Awaiter
+        {
+            Handle handle;
+
+            bool await_ready() const noexcept
+            {
+                return handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+            {
+                handle.promise().setContinuation(awaiter);
+                return handle;
+            }
+
+            T await_resume()
+            {
+                return handle.promise().result();
+            }
+        };
+        return Awaiter{ m_handle };
+    }
+
+private:
+    void reset()
+    {
+        if (m_handle)
+        {
+            std::exchange(m_handle, nullptr).destroy();
+        }
+    }
+
+    Handle m_handle;
+};
+
+template <typename T>
+CoTask<T> threads::CoPromise<T>::get_return_object() noexcept
+{
+    return CoTask<T>{ std::coroutine_handle<CoPromise>::from_promise(*this) };
+}
+
+inline CoTask<void> threads::CoPromise<void>::get_return_object() noexcept
+{
+    return CoTask<void>{ std::coroutine_handle<CoPromise>::from_promise(*this) };
+}
+
+// Run all tasks concurrently on `pool` and resume the caller once the last one finished. Void tasks yield
+// std::monostate, the first exception (in argument order) is rethrown after all tasks are done.
+template <typename Pool, typename... Ts>
+CoTask<std::tuple<threads::CoResult<Ts>...>> whenAll(Pool& pool, CoTask<Ts>... tasks)
+{
+    threads::CoLatch latch(sizeof...(Ts));
+    std::tuple<threads::CoSlot<Ts>...> slots;
+
+    auto members = std::apply(
+        [&](auto&... slot)
+        {
+            return std::array<threads::JoinMember, sizeof...(Ts)>{ threads::makeJoinMember(std::move(tasks),
+                                                                                            slot)... };
+        },
+        slots);
+    for (auto& member : members)
+    {
+        pool.enqueueDetach(
+            [handle = member.start(latch)]
+            {
+                handle.resume();
+            });
+    }
+    co_await latch;
+
+    co_return std::apply(
+        [](auto&... slot)
+        {
+            return std::tuple<threads::CoResult<Ts>...>{ slot.take()... };
+        },
+        slots);
+}
+
+// Same for a runtime number of tasks of one type, e.g. one per asset of a scene.
+template <typename Pool, typename T>
+CoTask<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> whenAll(Pool& pool, std::vector<CoTask<T>> tasks)
+{
+    threads::CoLatch latch(tasks.size());
+    std::vector<threads::CoSlot<T>> slots(tasks.size());
+    std::vector<threads::JoinMember> members;
+    members.reserve(tasks.size());
+    for (std::size_t i = 0; i < tasks.size(); ++i)
+    {
+        members.push_back(threads::makeJoinMember(std::move(tasks[i]), slots[i]));
+    }
+    for (auto& member : members)
+    {
+        pool.enqueueDetach(
+            [handle = member.start(latch)]
+            {
+                handle.resume();
+            });
+    }
+    co_await latch;
+
+    if constexpr (std::is_void_v<T>)
+    {
+        for (auto& slot : slots)
+        {
+            slot.take();
+        }
+    }
+    else
+    {
+        std::vector<T> results;
+        results.reserve(slots.size());
+        for (auto& slot : slots)
+        {
+            results.push_back(slot.take());
+        }
+        co_return results;
+    }
+}
+
+namespace threads
+{
+template <typename Pool>
+DetachedCoroutine runDetached(Pool& pool, CoTask<void> task)
+{
+    co_await pool.schedule();
+    co_await std::move(task);
+}
+} // namespace threads
+
+// Start `task` on `pool` without waiting for it. An exception escaping `task` goes to the pool's exception handler.
+template <typename Pool>
+void spawn(Pool& pool, CoTask<void> task)
+{
+    threads::runDetached(pool, std::move(task));
+}
+
+// Block the calling thread until `task` finished and return its result. This is the bridge from plain code (e.g.
+// the main loop) into coroutines, never call it from a pool worker.
+template <typename T>
+T syncWait(CoTask<T> task)
+{
+    threads::CoLatch latch(1);
+    threads::CoSlot<T> slot;
+    auto member = threads::makeJoinMember(std::move(task), slot);
+    member.start(latch).resume();
+    latch.wait();
+
+    if constexpr (std::is_void_v<T>)
+    {
+        slot.take();
+    }
+    else
+    {
+        return slot.take();
+    }
+}
+
+// Resumes coroutines once a condition they wait for holds, e.g. a VkFence got signaled. Nothing blocks on the
+// condition: whoever owns the poller calls poll() at a convenient point (once per frame after submitting, say) and
+// every satisfied waiter is rescheduled on its pool.
+//
+//   co_await poller.until(pool, [=] { return vkGetFenceStatus(device, fence) == VK_SUCCESS; });
+class CompletionPoller
+{
+    struct Waiter
+    {
+        bool (*ready)(Waiter*);
+        void (*resume)(Waiter*);
+    };
+
+    template <typename Pool, typename Predicate>
+    class Awaiter : Waiter
+    {
+    public:
+        Awaiter(CompletionPoller& poller, Pool& pool, Predicate predicate)
+            : Waiter{ &Awaiter::isReady, &Awaiter::reschedule }
+            , m_poller(poller)
+            , m_pool(pool)
+            , m_predicate(std::move(predicate))
+        {
+        }
+
+        bool await_ready()
+        {
+            return m_predicate();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            m_handle = handle;
+            m_poller.add(this);
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+
+    private:
+        static bool isReady(Waiter* waiter)
+        {
+            return static_cast<Awaiter*>(waiter)->m_predicate();
+        }
+
+        static void reschedule(Waiter* waiter)
+        {
+            auto* self = static_cast<Awaiter*>(waiter);
+            self->m_pool.enqueueDetach(
+                [handle = self->m_handle]
+                {
+                    handle.resume();
+                });
+        }
+
+        CompletionPoller& m_poller;
+        Pool& m_pool;
+        Predicate m_predicate;
+        std::coroutine_handle<> m_handle;
+    };
+
+public:
+    CompletionPoller() = default;
+
+    CompletionPoller(const CompletionPoller&)            = delete;
+    CompletionPoller& operator=(const CompletionPoller&) = delete;
+
+    template <typename Pool, typename Predicate>
+        requires std::is_invocable_r_v<bool, Predicate&>
+    auto until(Pool& pool, Predicate predicate)
+    {
+        return Awaiter<Pool, Predicate>{ *this, pool, std::move(predicate) };
+    }
+
+    // reschedule every waiter whose condition holds, returns how many were released
+    std::size_t poll();
+
+    [[nodiscard]] std::size_t pending() const;
+
+private:
+    void add(Waiter* waiter);
+
+    mutable std::mutex m_mutex;
+    std::vector<Waiter*> m_waiters;
+};
+
+} // namespace ana
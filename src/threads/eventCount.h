@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ana
+{
+
+// Eventcount: lets a consumer sleep on "no work" without losing wake-ups, and lets producers skip the syscall
+// entirely when nobody sleeps. Sleeping goes through std::atomic::wait, which is a futex on Linux.
+//
+//   auto key = ec.prepareWait();
+//   if (workAvailable()) { ec.cancelWait(); ... }
+//   else                 { ec.wait(key); }
+//
+// Producers publish the work first and then call notifyOne()/notifyAll().
+class EventCount
+{
+public:
+    using Key = std::uint32_t;
+
+    [[nodiscard]] Key prepareWait()
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return m_epoch.load(std::memory_order_seq_cst);
+    }
+
+    void cancelWait()
+    {
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void wait(Key key)
+    {
+        m_epoch.wait(key, std::memory_order_seq_cst);
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void notifyOne()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_seq_cst) != 0)
+        {
+            m_epoch.fetch_add(1, std::memory_order_seq_cst);
+            m_epoch.notify_one();
+        }
+    }
+
+    // wake up to `count` sleepers
+    void notify(std::size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::uint32_t waiting = m_waiters.load(std::memory_order_seq_cst);
+        if (waiting == 0)
+        {
+            return;
+        }
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (count >= waiting)
+        {
+            m_epoch.notify_all();
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            m_epoch.notify_one();
+        }
+    }
+
+    void notifyAll()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        m_epoch.notify_all();
+    }
+
+    [[nodiscard]] std::uint32_t waiters() const
+    {
+        return m_waiters.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint32_t> m_epoch{ 0 };
+    std::atomic<std::uint32_t> m_waiters{ 0 };
+};
+
+} // namespace ana
@@ -0,0 +1,638 @@
+#include "fileIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ANA_HAS_IO_URING 1
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#define ANA_HAS_IO_URING 0
+#endif
+
+namespace ana
+{
+
+namespace threads
+{
+struct FileOp
+{
+    FileRead request;
+    std::shared_ptr<const FileIO::Callback> callback;
+    // run the callback on the completion thread instead of dispatching it
+    bool direct = false;
+    FileReadResult result;
+    // where the bytes go and how many are wanted, see setTarget()
+    char* target       = nullptr;
+    std::size_t length = 0;
+    std::size_t done   = 0;
+#if ANA_HAS_IO_URING
+    int fd = -1;
+    iovec iov{};
+#endif
+};
+
+class FileEngine
+{
+public:
+    explicit FileEngine(FileIO::Dispatch dispatch)
+        : m_dispatch(std::move(dispatch))
+    {
+    }
+
+    virtual ~FileEngine() = default;
+
+    FileEngine(const FileEngine&)            = delete;
+    FileEngine& operator=(const FileEngine&) = delete;
+
+    [[nodiscard]] virtual FileIO::Backend kind() const = 0;
+    // takes ownership of the ops
+    virtual void submit(std::vector<FileOp*> ops) = 0;
+
+protected:
+    // where the data goes and how much of it, once the file size is known
+    static void setTarget(FileOp& op, std::uint64_t fileSize)
+    {
+        const auto& request = op.request;
+        if (!request.buffer.empty())
+        {
+            op.target = request.buffer.data();
+            op.length = request.length ? std::min(request.length, request.buffer.size()) : request.buffer.size();
+            return;
+        }
+        const std::uint64_t available = fileSize > request.offset ? fileSize - request.offset : 0;
+        op.length = static_cast<std::size_t>(request.length ? std::min<std::uint64_t>(request.length, available)
+                                                            : available);
+        op.result.data.resize(op.length);
+        op.target = op.result.data.data();
+    }
+
+    void complete(FileOp* raw)
+    {
+        std::unique_ptr<FileOp> op(raw);
+        op->result.bytes = { op->target, op->done };
+        if (!m_dispatch || op->direct)
+        {
+            (*op->callback)(std::move(op->result));
+            return;
+        }
+        m_dispatch(
+            [op = std::shared_ptr<FileOp>(std::move(op))]()
+            {
+                (*op->callback)(std::move(op->result));
+            });
+    }
+
+private:
+    FileIO::Dispatch m_dispatch;
+};
+} // namespace threads
+
+namespace
+{
+std::error_code lastError()
+{
+    return { errno ? errno : EIO, std::generic_category() };
+}
+
+// Portable fallback: a few threads doing blocking reads, so the callers never wait on the disk themselves.
+class ThreadEngine final : public threads::FileEngine
+{
+public:
+    ThreadEngine(FileIO::Dispatch dispatch, unsigned threadCount)
+        : FileEngine(std::move(dispatch))
+    {
+        for (unsigned i = 0; i < std::max(1u, threadCount); ++i)
+        {
+            m_threads.emplace_back(
+                [this](const std::stop_token& stop_tok)
+                {
+                    run(stop_tok);
+                });
+        }
+    }
+
+    ~ThreadEngine() override
+    {
+        for (auto& thread : m_threads)
+        {
+            thread.request_stop();
+        }
+        m_wakeup.notify_all();
+        // jthread joins, the threads drain the queue before they stop
+        m_threads.clear();
+    }
+
+    [[nodiscard]] FileIO::Backend kind() const override
+    {
+        return FileIO::Backend::Threads;
+    }
+
+    void submit(std::vector<threads::FileOp*> ops) override
+    {
+        {
+            std::scoped_lock lk(m_mutex);
+            m_queue.insert(m_queue.end(), ops.begin(), ops.end());
+        }
+        m_wakeup.notify_all();
+    }
+
+private:
+    void run(const std::stop_token& stop_tok)
+    {
+        while (true)
+        {
+            threads::FileOp* op = nullptr;
+            {
+                std::unique_lock lk(m_mutex);
+                m_wakeup.wait(lk,
+                              [&]
+                              {
+                                  return !m_queue.empty() || stop_tok.stop_requested();
+                              });
+                if (m_queue.empty())
+                {
+                    return;
+                }
+                op = m_queue.front();
+                m_queue.pop_front();
+            }
+            readFile(*op);
+            complete(op);
+        }
+    }
+
+    static void readFile(threads::FileOp& op)
+    {
+        errno = 0;
+        std::ifstream file{ op.request.path, std::ios::ate | std::ios::binary };
+        if (!file.is_open())
+        {
+            op.result.error = lastError();
+            return;
+        }
+        setTarget(op, static_cast<std::uint64_t>(file.tellg()));
+        if (op.length == 0)
+        {
+            return;
+        }
+        file.seekg(static_cast<std::streamoff>(op.request.offset));
+        file.read(op.target, static_cast<std::streamsize>(op.length));
+        op.done = static_cast<std::size_t>(file.gcount());
+        if (file.bad())
+        {
+            op.result.error = lastError();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<threads::FileOp*> m_queue;
+    std::vector<std::jthread> m_threads;
+};
+
+#if ANA_HAS_IO_URING
+// Raw io_uring: submitters fill SQEs under a mutex and enter the ring without waiting, one reaper thread waits
+// for completions, resubmits short reads and hands finished reads on. Files are opened by the submitter.
+class UringEngine final : public threads::FileEngine
+{
+    // one readv at most this big, longer reads are resubmitted in pieces
+    static constexpr std::size_t MaxChunk = std::size_t{ 1 } << 30;
+    // user_data of the NOP that stops the reaper
+    static constexpr std::uint64_t StopToken = 0;
+
+public:
+    static std::unique_ptr<UringEngine> create(FileIO::Dispatch dispatch, unsigned depth)
+    {
+        io_uring_params params{};
+        const int ring = static_cast<int>(::syscall(__NR_io_uring_setup, std::max(depth, 2u), &params));
+        if (ring < 0)
+        {
+            // ENOSYS on old kernels, EPERM in sandboxes that filter it
+            return nullptr;
+        }
+        auto engine = std::unique_ptr<UringEngine>(new UringEngine(std::move(dispatch), ring, params));
+        if (!engine->map(params))
+        {
+            return nullptr;
+        }
+        engine->m_reaper = std::jthread(
+            [raw = engine.get()]
+            {
+                raw->reap();
+            });
+        return engine;
+    }
+
+    ~UringEngine() override
+    {
+        if (m_reaper.joinable())
+        {
+            std::unique_lock lk(m_mutex);
+            m_idle.wait(lk,
+                        [this]
+                        {
+                            return m_inflight == 0 && m_backlog.empty();
+                        });
+            // nothing is in flight, so a refused NOP can only be a transient shortage; the reaper has no other way out
+            std::vector<threads::FileOp*> none;
+            do
+            {
+                io_uring_sqe* sqe = nextSqe();
+                sqe->opcode       = IORING_OP_NOP;
+                sqe->user_data    = StopToken;
+            } while (!flush(none));
+            lk.unlock();
+            m_reaper.join();
+        }
+        if (m_sqes != MAP_FAILED)
+        {
+            ::munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+        {
+            ::munmap(m_cqRing, m_cqSize);
+        }
+        if (m_sqRing != MAP_FAILED)
+        {
+            ::munmap(m_sqRing, m_sqSize);
+        }
+        ::close(m_ring);
+    }
+
+    [[nodiscard]] FileIO::Backend kind() const override
+    {
+        return FileIO::Backend::IoUring;
+    }
+
+    void submit(std::vector<threads::FileOp*> ops) override
+    {
+        std::vector<threads::FileOp*> failed;
+        {
+            std::scoped_lock lk(m_mutex);
+            for (auto* op : ops)
+            {
+                if (!open(*op))
+                {
+                    failed.push_back(op);
+                }
+                else if (m_inflight < m_depth)
+                {
+                    ++m_inflight;
+                    pushRead(*op);
+                }
+                else
+                {
+                    m_backlog.push_back(op);
+                }
+            }
+            pump(failed);
+        }
+        for (auto* op : failed)
+        {
+            finish(op);
+        }
+    }
+
+private:
+    UringEngine(FileIO::Dispatch dispatch, int ring, const io_uring_params& params)
+        : FileEngine(std::move(dispatch))
+        , m_ring(ring)
+        , m_depth(params.sq_entries)
+    {
+    }
+
+    static int enter(int ring, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    template <typename T>
+    T* at(void* base, std::uint32_t offset)
+    {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    bool map(const io_uring_params& params)
+    {
+        m_sqSize = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+        m_cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+        {
+            m_sqSize = m_cqSize = std::max(m_sqSize, m_cqSize);
+        }
+
+        m_sqRing = ::mmap(nullptr, m_sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring,
+                          IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED)
+        {
+            return false;
+        }
+        m_cqRing = single ? m_sqRing
+                          : ::mmap(nullptr, m_cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring,
+                                   IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED)
+        {
+            return false;
+        }
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes     = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring,
+                            IORING_OFF_SQES);
+        if (m_sqes == MAP_FAILED)
+        {
+            return false;
+        }
+
+        m_sqHead  = at<std::uint32_t>(m_sqRing, params.sq_off.head);
+        m_sqTail  = at<std::uint32_t>(m_sqRing, params.sq_off.tail);
+        m_sqMask  = *at<std::uint32_t>(m_sqRing, params.sq_off.ring_mask);
+        m_sqArray = at<std::uint32_t>(m_sqRing, params.sq_off.array);
+        m_cqHead  = at<std::uint32_t>(m_cqRing, params.cq_off.head);
+        m_cqTail  = at<std::uint32_t>(m_cqRing, params.cq_off.tail);
+        m_cqMask  = *at<std::uint32_t>(m_cqRing, params.cq_off.ring_mask);
+        m_cqes    = at<io_uring_cqe>(m_cqRing, params.cq_off.cqes);
+        return true;
+    }
+
+    bool open(threads::FileOp& op)
+    {
+        op.fd = ::open(op.request.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (op.fd < 0)
+        {
+            op.result.error = lastError();
+            return false;
+        }
+        struct stat info{};
+        if (op.request.buffer.empty() && ::fstat(op.fd, &info) != 0)
+        {
+            op.result.error = lastError();
+            return false;
+        }
+        setTarget(op, static_cast<std::uint64_t>(info.st_size));
+        // nothing to read still goes through the ring, keeps the completion path in one place
+        return true;
+    }
+
+    // m_mutex held, the SQ always has room because at most m_depth reads are in flight
+    io_uring_sqe* nextSqe()
+    {
+        const std::uint32_t tail  = *m_sqTail;
+        const std::uint32_t index = tail & m_sqMask;
+        auto* sqe                 = static_cast<io_uring_sqe*>(m_sqes) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        m_sqArray[index] = index;
+        std::atomic_ref(*m_sqTail).store(tail + 1, std::memory_order_release);
+        return sqe;
+    }
+
+    // m_mutex held
+    void pushRead(threads::FileOp& op)
+    {
+        op.iov.iov_base   = op.target + op.done;
+        op.iov.iov_len    = std::min(op.length - op.done, MaxChunk);
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode       = IORING_OP_READV;
+        sqe->fd           = op.fd;
+        sqe->addr         = reinterpret_cast<std::uintptr_t>(&op.iov);
+        sqe->len          = 1;
+        sqe->off          = op.request.offset + op.done;
+        sqe->user_data    = reinterpret_cast<std::uintptr_t>(&op);
+    }
+
+    // m_mutex held. Hand every filled SQE to the kernel; whatever it refuses with EBUSY (full CQ) goes out with the
+    // next flush after the reaper made room. On any other error the SQEs are taken back, their reads go to `failed`
+    // with the error set and false is returned.
+    bool flush(std::vector<threads::FileOp*>& failed)
+    {
+        while (true)
+        {
+            const std::uint32_t head    = std::atomic_ref(*m_sqHead).load(std::memory_order_acquire);
+            const std::uint32_t pending = *m_sqTail - head;
+            if (pending == 0)
+            {
+                return true;
+            }
+            if (enter(m_ring, pending, 0, 0) >= 0 || errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EBUSY)
+            {
+                return true;
+            }
+
+            // without SQPOLL the kernel only consumes SQEs inside an enter that submits, and those all hold m_mutex
+            const std::error_code error(errno, std::system_category());
+            for (std::uint32_t entry = head; entry != *m_sqTail; ++entry)
+            {
+                const auto& sqe = static_cast<io_uring_sqe*>(m_sqes)[m_sqArray[entry & m_sqMask]];
+                if (sqe.user_data != StopToken)
+                {
+                    auto* op         = reinterpret_cast<threads::FileOp*>(static_cast<std::uintptr_t>(sqe.user_data));
+                    op->result.error = error;
+                    --m_inflight;
+                    failed.push_back(op);
+                }
+            }
+            std::atomic_ref(*m_sqTail).store(head, std::memory_order_release);
+            return false;
+        }
+    }
+
+    // m_mutex held. Start backlogged reads while there is room and flush, reads the kernel refuses end up in
+    // `failed`. A refused batch frees room, so the backlog is retried until it is either in flight or failed too.
+    void pump(std::vector<threads::FileOp*>& failed)
+    {
+        do
+        {
+            while (m_inflight < m_depth && !m_backlog.empty())
+            {
+                ++m_inflight;
+                pushRead(*m_backlog.front());
+                m_backlog.pop_front();
+            }
+        } while (!flush(failed));
+
+        if (m_inflight == 0 && m_backlog.empty())
+        {
+            m_idle.notify_all();
+        }
+    }
+
+    void finish(threads::FileOp* op)
+    {
+        if (op->fd >= 0)
+        {
+            ::close(op->fd);
+        }
+        complete(op);
+    }
+
+    void reap()
+    {
+        std::vector<threads::FileOp*> finished;
+        while (true)
+        {
+            enter(m_ring, 0, 1, IORING_ENTER_GETEVENTS);
+
+            bool stop                = false;
+            std::uint32_t head       = *m_cqHead;
+            const std::uint32_t tail = std::atomic_ref(*m_cqTail).load(std::memory_order_acquire);
+            std::unique_lock lk(m_mutex);
+            for (; head != tail; ++head)
+            {
+                const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+                if (cqe.user_data == StopToken)
+                {
+                    stop = true;
+                    continue;
+                }
+                auto* op = reinterpret_cast<threads::FileOp*>(static_cast<std::uintptr_t>(cqe.user_data));
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+                {
+                    pushRead(*op);
+                    continue;
+                }
+                if (cqe.res < 0)
+                {
+                    op->result.error = { -cqe.res, std::generic_category() };
+                }
+                else
+                {
+                    op->done += static_cast<std::size_t>(cqe.res);
+                    // a short read that isn't the end of the file
+                    if (cqe.res > 0 && op->done < op->length)
+                    {
+                        pushRead(*op);
+                        continue;
+                    }
+                }
+                finished.push_back(op);
+            }
+            std::atomic_ref(*m_cqHead).store(head, std::memory_order_release);
+
+            m_inflight -= static_cast<unsigned>(finished.size());
+            pump(finished);
+
+            // callbacks may submit new reads, so not under the lock
+            lk.unlock();
+            for (auto* op : finished)
+            {
+                finish(op);
+            }
+            finished.clear();
+            if (stop)
+            {
+                return;
+            }
+        }
+    }
+
+    const int m_ring;
+    const unsigned m_depth;
+    void* m_sqRing       = MAP_FAILED;
+    void* m_cqRing       = MAP_FAILED;
+    void* m_sqes         = MAP_FAILED;
+    std::size_t m_sqSize = 0;
+    std::size_t m_cqSize = 0;
+    std::size_t m_sqesSize = 0;
+    std::uint32_t* m_sqHead  = nullptr;
+    std::uint32_t* m_sqTail  = nullptr;
+    std::uint32_t m_sqMask   = 0;
+    std::uint32_t* m_sqArray = nullptr;
+    std::uint32_t* m_cqHead  = nullptr;
+    std::uint32_t* m_cqTail  = nullptr;
+    std::uint32_t m_cqMask   = 0;
+    io_uring_cqe* m_cqes     = nullptr;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    unsigned m_inflight = 0;
+    std::deque<threads::FileOp*> m_backlog;
+    std::jthread m_reaper;
+};
+#endif
+
+std::unique_ptr<threads::FileEngine> createEngine(FileIO::Dispatch dispatch, const FileIOConfig& config)
+{
+#if ANA_HAS_IO_URING
+    if (!config.forceFallback)
+    {
+        if (auto engine = UringEngine::create(dispatch, config.queueDepth))
+        {
+            return engine;
+        }
+    }
+#endif
+    return std::make_unique<ThreadEngine>(std::move(dispatch), config.fallbackThreads);
+}
+} // namespace
+
+FileIO::FileIO(Dispatch dispatch, FileIOConfig config)
+    : m_engine(createEngine(std::move(dispatch), config))
+{
+}
+
+FileIO::~FileIO() = default;
+
+FileIO::Backend FileIO::backend() const
+{
+    return m_engine->kind();
+}
+
+void FileIO::read(FileRead request, Callback callback)
+{
+    std::vector<FileRead> requests;
+    requests.push_back(std::move(request));
+    readBatch(std::move(requests), std::move(callback));
+}
+
+void FileIO::readBatch(std::vector<FileRead> requests, Callback callback)
+{
+    auto shared = std::make_shared<const Callback>(std::move(callback));
+    std::vector<threads::FileOp*> ops;
+    ops.reserve(requests.size());
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        auto* op         = new threads::FileOp{};
+        op->request      = std::move(requests[i]);
+        op->callback     = shared;
+        op->result.index = i;
+        ops.push_back(op);
+    }
+    m_engine->submit(std::move(ops));
+}
+
+TaskFuture<FileReadResult> FileIO::read(FileRead request)
+{
+    auto promise = std::make_shared<TaskPromise<FileReadResult>>();
+    auto future  = promise->getFuture();
+
+    auto* op     = new threads::FileOp{};
+    op->request  = std::move(request);
+    op->direct   = true;
+    op->callback = std::make_shared<const Callback>(
+        [promise](FileReadResult result)
+        {
+            promise->setValue(std::move(result));
+        });
+    m_engine->submit({ op });
+    return future;
+}
+
+} // namespace ana
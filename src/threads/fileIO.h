@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "taskFuture.h"
+
+namespace ana
+{
+
+struct FileIOConfig
+{
+    // reads in flight on the io_uring ring at once, the rest wait in a backlog
+    unsigned queueDepth = 64;
+    // I/O threads of the fallback backend
+    unsigned fallbackThreads = 4;
+    // use the fallback even where io_uring is available
+    bool forceFallback = false;
+};
+
+struct FileRead
+{
+    std::string path;
+    // Read into this buffer (e.g. a mapped staging buffer) instead of one allocated by the service. Must stay valid
+    // until the read completed.
+    std::span<char> buffer{};
+    std::uint64_t offset = 0;
+    // 0 reads up to the end of the file, or as much as fits into `buffer`
+    std::size_t length = 0;
+};
+
+struct FileReadResult
+{
+    // position of the request in its readBatch()
+    std::size_t index = 0;
+    // storage allocated by the service when the request had no buffer
+    std::vector<char> data;
+    // what was read, inside `data` or the caller's buffer; short at the end of the file
+    std::span<char> bytes;
+    std::error_code error;
+};
+
+namespace threads
+{
+struct FileOp;
+class FileEngine;
+} // namespace threads
+
+// Asynchronous file reads. On Linux the reads go through io_uring (raw syscalls, no liburing) with a single
+// completion thread; where io_uring is missing or not permitted a few I/O threads do blocking reads instead.
+// Either way callers never block on the disk, and completion callbacks are handed to the dispatcher, typically a
+// ThreadPool.
+class FileIO
+{
+public:
+    enum class Backend
+    {
+        IoUring,
+        Threads,
+    };
+
+    using Task     = std::function<void()>;
+    using Dispatch = std::function<void(Task)>;
+    using Callback = std::function<void(FileReadResult)>;
+
+    // Without a dispatcher callbacks run on the service's own completion threads, so they should be short.
+    explicit FileIO(Dispatch dispatch = {}, FileIOConfig config = {});
+
+    // callbacks run as tasks on `pool`
+    template <typename Pool>
+        requires requires(Pool& pool, Task task) { pool.enqueueDetach(std::move(task)); }
+    explicit FileIO(Pool& pool, FileIOConfig config = {})
+        : FileIO(Dispatch(
+                     [&pool](Task task)
+                     {
+                         pool.enqueueDetach(std::move(task));
+                     }),
+                 config)
+    {
+    }
+
+    // waits for all reads in flight, their callbacks may still be queued on the dispatcher afterwards
+    ~FileIO();
+
+    FileIO(const FileIO&)            = delete;
+    FileIO& operator=(const FileIO&) = delete;
+
+    [[nodiscard]] Backend backend() const;
+
+    void read(FileRead request, Callback callback);
+
+    // All requests are submitted together (one io_uring_enter). `callback` runs once per request, the result's
+    // index tells which one.
+    void readBatch(std::vector<FileRead> requests, Callback callback);
+
+    // The future is completed right on the completion thread, without going through the dispatcher.
+    [[nodiscard]] TaskFuture<FileReadResult> read(FileRead request);
+
+private:
+    std::unique_ptr<threads::FileEngine> m_engine;
+};
+
+} // namespace ana
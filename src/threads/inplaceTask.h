@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ana
+{
+
+// Move-only void() callable with a fixed inline buffer and no heap fallback. Callables that do not fit are
+// rejected at compile time. Can be used as the FunctionType of ThreadPool:
+//
+//   ana::ThreadPool<ana::InplaceTask<64>> pool;
+template <std::size_t Capacity = 64>
+class InplaceTask
+{
+    struct VTable
+    {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+
+    template <typename Function>
+    static constexpr VTable VTableFor{
+        [](void* self)
+        {
+            std::invoke(*static_cast<Function*>(self));
+        },
+        [](void* dst, void* src)
+        {
+            ::new (dst) Function(std::move(*static_cast<Function*>(src)));
+            static_cast<Function*>(src)->~Function();
+        },
+        [](void* self)
+        {
+            static_cast<Function*>(self)->~Function();
+        },
+    };
+
+public:
+    static constexpr std::size_t capacity = Capacity;
+
+    InplaceTask() = default;
+
+    template <typename Function, typename Decayed = std::decay_t<Function>>
+        requires(!std::is_same_v<Decayed, InplaceTask> && std::is_invocable_r_v<void, Decayed&>)
+    InplaceTask(Function&& func)
+    {
+        static_assert(sizeof(Decayed) <= Capacity, "callable does not fit into InplaceTask, raise the capacity");
+        static_assert(alignof(Decayed) <= alignof(std::max_align_t), "over-aligned callable");
+        static_assert(std::is_nothrow_move_constructible_v<Decayed>, "callable must be nothrow move constructible");
+
+        ::new (static_cast<void*>(m_storage)) Decayed(std::forward<Function>(func));
+        m_vtable = &VTableFor<Decayed>;
+    }
+
+    InplaceTask(InplaceTask&& other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    InplaceTask& operator=(InplaceTask&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceTask(const InplaceTask&)            = delete;
+    InplaceTask& operator=(const InplaceTask&) = delete;
+
+    ~InplaceTask()
+    {
+        reset();
+    }
+
+    void operator()()
+    {
+        m_vtable->invoke(m_storage);
+    }
+
+    explicit operator bool() const
+    {
+        return m_vtable != nullptr;
+    }
+
+    void reset()
+    {
+        if (m_vtable)
+        {
+            m_vtable->destroy(m_storage);
+            m_vtable = nullptr;
+        }
+    }
+
+private:
+    void moveFrom(InplaceTask& other)
+    {
+        if (other.m_vtable)
+        {
+            other.m_vtable->move(m_storage, other.m_storage);
+            m_vtable = std::exchange(other.m_vtable, nullptr);
+        }
+    }
+
+    alignas(std::max_align_t) std::byte m_storage[Capacity];
+    const VTable* m_vtable = nullptr;
+};
+
+} // namespace ana
@@ -0,0 +1,127 @@
+#include "locks.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace ana::threads
+{
+
+namespace
+{
+struct SiteRegistry
+{
+    std::mutex mutex;
+    // deque: sites never move once handed out
+    std::deque<LockSite> sites;
+};
+
+SiteRegistry& registry()
+{
+    // never destroyed, locks in other static objects may still report to it during shutdown
+    static auto* s_registry = new SiteRegistry();
+    return *s_registry;
+}
+void add(LockCounters& total, const LockCounters& counters)
+{
+    const auto sum = [](std::atomic_uint64_t& into, const std::atomic_uint64_t& from)
+    {
+        into.store(into.load(std::memory_order_relaxed) + from.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    };
+    sum(total.acquisitions, counters.acquisitions);
+    sum(total.contended, counters.contended);
+    sum(total.waitNs, counters.waitNs);
+    const auto longest = counters.maxWaitNs.load(std::memory_order_relaxed);
+    if (total.maxWaitNs.load(std::memory_order_relaxed) < longest)
+    {
+        total.maxWaitNs.store(longest, std::memory_order_relaxed);
+    }
+}
+
+void clear(LockCounters& counters)
+{
+    counters.acquisitions.store(0, std::memory_order_relaxed);
+    counters.contended.store(0, std::memory_order_relaxed);
+    counters.waitNs.store(0, std::memory_order_relaxed);
+    counters.maxWaitNs.store(0, std::memory_order_relaxed);
+}
+} // namespace
+
+LockSite& lockSite(std::string_view name)
+{
+    auto& reg = registry();
+    std::scoped_lock lk(reg.mutex);
+    const auto found = std::find_if(reg.sites.begin(), reg.sites.end(),
+                                    [&](const LockSite& site)
+                                    {
+                                        return site.name == name;
+                                    });
+    if (found != reg.sites.end())
+    {
+        return *found;
+    }
+    return reg.sites.emplace_back(std::string(name));
+}
+
+void attachLock(LockSite& site, LockCounters& counters)
+{
+    auto& reg = registry();
+    std::scoped_lock lk(reg.mutex);
+    site.locks.push_back(&counters);
+}
+
+void detachLock(LockSite& site, const LockCounters& counters)
+{
+    auto& reg = registry();
+    std::scoped_lock lk(reg.mutex);
+    add(site.retired, counters);
+    std::erase(site.locks, &counters);
+}
+
+std::vector<LockSiteStats> lockProfile()
+{
+    std::vector<LockSiteStats> profile;
+    {
+        auto& reg = registry();
+        std::scoped_lock lk(reg.mutex);
+        for (const auto& site : reg.sites)
+        {
+            LockCounters total;
+            add(total, site.retired);
+            for (const auto* counters : site.locks)
+            {
+                add(total, *counters);
+            }
+            const auto acquisitions = total.acquisitions.load(std::memory_order_relaxed);
+            if (acquisitions == 0)
+            {
+                continue;
+            }
+            profile.push_back({ site.name, acquisitions, total.contended.load(std::memory_order_relaxed),
+                                total.waitNs.load(std::memory_order_relaxed),
+                                total.maxWaitNs.load(std::memory_order_relaxed) });
+        }
+    }
+    std::sort(profile.begin(), profile.end(),
+              [](const LockSiteStats& a, const LockSiteStats& b)
+              {
+                  return a.waitNs > b.waitNs;
+              });
+    return profile;
+}
+
+void resetLockProfile()
+{
+    auto& reg = registry();
+    std::scoped_lock lk(reg.mutex);
+    for (auto& site : reg.sites)
+    {
+        clear(site.retired);
+        for (auto* counters : site.locks)
+        {
+            clear(*counters);
+        }
+    }
+}
+
+} // namespace ana::threads
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "backoff.h"
+
+namespace ana
+{
+
+template <typename Lock>
+concept is_lockable = requires(Lock&& lock) {
+    lock.lock();
+    lock.unlock();
+    { lock.try_lock() } -> std::convertible_to<bool>;
+};
+
+// Test-and-test-and-set spinlock. Waiters spin on a plain load so the cache line stays shared until the holder
+// releases it, back off exponentially and start yielding when the wait gets long (e.g. the holder got preempted).
+// For critical sections of a few dozen instructions; anything longer wants a std::mutex.
+class SpinLock
+{
+public:
+    // backoff rounds before waiters yield the CPU between checks
+    static constexpr std::uint32_t YieldAfter = 16;
+
+    void lock()
+    {
+        Backoff backoff;
+        std::uint32_t rounds = 0;
+        while (m_locked.exchange(true, std::memory_order_acquire))
+        {
+            while (m_locked.load(std::memory_order_relaxed))
+            {
+                if (++rounds < YieldAfter)
+                {
+                    backoff.pause();
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] bool try_lock()
+    {
+        return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock()
+    {
+        m_locked.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic_bool m_locked{ false };
+};
+
+// FIFO spinlock: waiters take a ticket and are served in order, so nobody starves under contention. Waiters back
+// off in proportion to their distance from the head of the line. Strict FIFO means a preempted waiter stalls
+// everybody behind it, so only use it with no more contending threads than cores (e.g. among pool workers).
+class TicketLock
+{
+public:
+    void lock()
+    {
+        const std::uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+        std::uint32_t rounds       = 0;
+        while (true)
+        {
+            const std::uint32_t serving = m_serving.load(std::memory_order_acquire);
+            if (serving == ticket)
+            {
+                return;
+            }
+            if (++rounds < SpinLock::YieldAfter)
+            {
+                for (std::uint32_t i = ticket - serving; i > 0; --i)
+                {
+                    cpuRelax();
+                }
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // only succeeds if nobody holds or waits for the lock
+    [[nodiscard]] bool try_lock()
+    {
+        std::uint32_t serving = m_serving.load(std::memory_order_relaxed);
+        return m_next.compare_exchange_strong(serving, serving + 1, std::memory_order_acquire,
+                                              std::memory_order_relaxed);
+    }
+
+    void unlock()
+    {
+        m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    std::atomic_uint32_t m_next{ 0 };
+    std::atomic_uint32_t m_serving{ 0 };
+};
+
+namespace threads
+{
+struct LockSiteStats
+{
+    std::string site;
+    std::uint64_t acquisitions = 0;
+    // acquisitions that had to wait because the lock was taken
+    std::uint64_t contended = 0;
+    std::uint64_t waitNs    = 0;
+    std::uint64_t maxWaitNs = 0;
+};
+
+// Counters of one ProfiledLock. Only the thread holding the lock writes them, so they share the lock's cache line
+// instead of one line per site that every acquisition would fight over; readers sum them up per site.
+struct LockCounters
+{
+    std::atomic_uint64_t acquisitions{};
+    std::atomic_uint64_t contended{};
+    std::atomic_uint64_t waitNs{};
+    std::atomic_uint64_t maxWaitNs{};
+};
+
+// Where ProfiledLocks created at the same spot report to. Sites live until the program ends, the lists are only
+// touched by the functions below.
+struct LockSite
+{
+    const std::string name;
+    // locks alive right now
+    std::vector<LockCounters*> locks{};
+    // what destroyed locks had counted
+    LockCounters retired{};
+};
+
+// the site registered under `name`, created on first use
+LockSite& lockSite(std::string_view name);
+// add a lock's counters to / fold them into `site`, called by ProfiledLock's constructor and destructor
+void attachLock(LockSite& site, LockCounters& counters);
+void detachLock(LockSite& site, const LockCounters& counters);
+
+// all sites with at least one acquisition, most waited on first
+std::vector<LockSiteStats> lockProfile();
+// counts a lock is updating at the same moment may survive the reset
+void resetLockProfile();
+} // namespace threads
+
+// Wraps a lock and records per site how often it was taken, how often that meant waiting and for how long. The
+// site defaults to where the lock is constructed (for a member: the constructor or member initializer that creates
+// it, so a class holding one should take a site and pass it on, like ThreadSafeQueue does), pass a name to tell
+// instances apart. Uncontended acquisitions cost one try_lock() plus an increment of a counter next to the lock,
+// only contended ones read the clock.
+//
+//   ana::ThreadSafeQueue<Job, ana::ProfiledLock<ana::SpinLock>> jobs; // reported under this line
+//   ana::ThreadSafeQueue<Job, ana::ProfiledLock<ana::SpinLock>> uploads{ "uploads" };
+//   ...
+//   for (const auto& site : ana::threads::lockProfile()) { ... }
+template <typename Lock = std::mutex>
+    requires is_lockable<Lock>
+class ProfiledLock
+{
+public:
+    explicit ProfiledLock(std::source_location where = std::source_location::current())
+        : ProfiledLock(std::string(where.file_name()) + ":" + std::to_string(where.line()))
+    {
+    }
+
+    explicit ProfiledLock(std::string_view name)
+        : m_site(&threads::lockSite(name))
+    {
+        threads::attachLock(*m_site, m_counters);
+    }
+
+    ~ProfiledLock()
+    {
+        threads::detachLock(*m_site, m_counters);
+    }
+
+    ProfiledLock(const ProfiledLock&)            = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+    void lock()
+    {
+        if (m_lock.try_lock())
+        {
+            bump(m_counters.acquisitions, 1);
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        m_lock.lock();
+        const auto waited = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+        bump(m_counters.acquisitions, 1);
+        bump(m_counters.contended, 1);
+        bump(m_counters.waitNs, waited);
+        if (m_counters.maxWaitNs.load(std::memory_order_relaxed) < waited)
+        {
+            m_counters.maxWaitNs.store(waited, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] bool try_lock()
+    {
+        if (!m_lock.try_lock())
+        {
+            return false;
+        }
+        bump(m_counters.acquisitions, 1);
+        return true;
+    }
+
+    void unlock()
+    {
+        m_lock.unlock();
+    }
+
+private:
+    // we hold the lock, so a plain load and store is enough, the atomics are only there for the readers
+    static void bump(std::atomic_uint64_t& counter, std::uint64_t amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    Lock m_lock{};
+    threads::LockCounters m_counters{};
+    threads::LockSite* m_site;
+};
+
+} // namespace ana
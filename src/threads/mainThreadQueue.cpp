@@ -0,0 +1,79 @@
+#include "mainThreadQueue.h"
+
+#include <cassert>
+
+namespace ana
+{
+
+MainThreadQueue::MainThreadQueue()
+    : m_owner(std::this_thread::get_id())
+{
+}
+
+std::size_t MainThreadQueue::drain()
+{
+    assert(isOwnerThread() && "MainThreadQueue drained from a thread other than its owner");
+    {
+        std::scoped_lock lk(m_mutex);
+        m_woken = false;
+        if (m_pending.empty())
+        {
+            return 0;
+        }
+        std::swap(m_pending, m_running);
+    }
+
+    // post() only reports exceptions through the future, so nothing escapes here
+    for (auto& task : m_running)
+    {
+        task();
+    }
+    const std::size_t count = m_running.size();
+    m_running.clear();
+    return count;
+}
+
+std::size_t MainThreadQueue::drainWait(std::chrono::microseconds timeout)
+{
+    {
+        std::unique_lock lk(m_mutex);
+        m_wakeup.wait_for(lk, timeout,
+                          [this]
+                          {
+                              return m_woken || !m_pending.empty();
+                          });
+    }
+    return drain();
+}
+
+void MainThreadQueue::wake()
+{
+    {
+        std::scoped_lock lk(m_mutex);
+        m_woken = true;
+    }
+    m_wakeup.notify_one();
+}
+
+std::size_t MainThreadQueue::pending() const
+{
+    std::scoped_lock lk(m_mutex);
+    return m_pending.size();
+}
+
+void MainThreadQueue::push(Task task)
+{
+    bool first = false;
+    {
+        std::scoped_lock lk(m_mutex);
+        first = m_pending.empty();
+        m_pending.push_back(std::move(task));
+    }
+    // the owner only sleeps on an empty queue
+    if (first)
+    {
+        m_wakeup.notify_one();
+    }
+}
+
+} // namespace ana
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef __has_include
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#include "taskFuture.h"
+
+namespace ana
+{
+
+// Tasks that have to run on one particular thread, typically GLFW window calls and present, which must stay on the
+// main thread. Any thread may post(); the owner (the thread that constructed the queue) runs them at a fixed point
+// of its loop with drain() or drainWait().
+//
+// Don't wait on a future from the owner thread unless the owner drains meanwhile, the task would never run.
+// Tasks still queued when the queue dies never run, their futures report a broken promise.
+class MainThreadQueue
+{
+public:
+#ifdef __cpp_lib_move_only_function
+    using Task = std::move_only_function<void()>;
+#else
+    using Task = std::function<void()>;
+#endif
+
+    MainThreadQueue();
+
+    MainThreadQueue(const MainThreadQueue&)            = delete;
+    MainThreadQueue& operator=(const MainThreadQueue&) = delete;
+
+    template <typename Function, typename... Args, typename ReturnType = std::invoke_result_t<Function&&, Args&&...>>
+        requires std::invocable<Function, Args...>
+    [[nodiscard]] TaskFuture<ReturnType> post(Function f, Args... args)
+    {
+        TaskPromise<ReturnType> promise;
+        auto future = promise.getFuture();
+        auto task   = [func = std::move(f), ... largs = std::move(args), promise = std::move(promise)]() mutable
+        {
+            try
+            {
+                if constexpr (std::is_same_v<ReturnType, void>)
+                {
+                    func(largs...);
+                    promise.setValue();
+                }
+                else
+                {
+                    promise.setValue(func(largs...));
+                }
+            }
+            catch (...)
+            {
+                promise.setException(std::current_exception());
+            }
+        };
+#ifdef __cpp_lib_move_only_function
+        push(std::move(task));
+#else
+        // std::function needs a copyable callable, the promise is move-only
+        push(
+            [shared = std::make_shared<decltype(task)>(std::move(task))]()
+            {
+                (*shared)();
+            });
+#endif
+        return future;
+    }
+
+    // Owner only. Runs everything posted before the call and returns how many tasks ran; tasks posted by those
+    // tasks wait for the next drain.
+    std::size_t drain();
+
+    // Owner only. Like drain(), but first waits up to `timeout` for a task or a wake() if nothing is queued. Lets
+    // the main thread service posted work while it waits for the pool to finish a frame.
+    std::size_t drainWait(std::chrono::microseconds timeout);
+
+    // end a drainWait() early, e.g. when the frame the owner waits for is done
+    void wake();
+
+    [[nodiscard]] bool isOwnerThread() const
+    {
+        return std::this_thread::get_id() == m_owner;
+    }
+
+    [[nodiscard]] std::size_t pending() const;
+
+private:
+    void push(Task task);
+
+    const std::thread::id m_owner;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::vector<Task> m_pending;
+    // swapped with m_pending on drain, keeps its capacity so steady-state posting does not allocate
+    std::vector<Task> m_running;
+    bool m_woken = false;
+};
+
+} // namespace ana
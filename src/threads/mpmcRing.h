@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "workStealingDeque.h"
+
+namespace ana
+{
+
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's design). Each cell carries a sequence
+// number telling whether it is free for the producer of a given lap or full for its consumer, so producers and
+// consumers only contend on their own index. Never allocates after construction; try_push() fails when full.
+template <typename T>
+    requires std::is_nothrow_move_constructible_v<T>
+class MpmcRing
+{
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* value()
+        {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    // capacity is rounded up to a power of two
+    explicit MpmcRing(std::size_t capacity)
+        : m_mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1)
+        , m_cells(std::make_unique<Cell[]>(m_mask + 1))
+    {
+        for (std::size_t i = 0; i <= m_mask; ++i)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpmcRing()
+    {
+        while (try_pop())
+        {
+        }
+    }
+
+    MpmcRing(const MpmcRing&)            = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    template <typename... Args>
+    [[nodiscard]] bool try_emplace(Args&&... args)
+    {
+        std::size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell      = m_cells[pos & m_mask];
+            const auto diff = static_cast<std::ptrdiff_t>(cell.sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0)
+            {
+                if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    ::new (static_cast<void*>(cell.storage)) T(std::forward<Args>(args)...);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // the consumer of the previous lap hasn't freed the cell yet: full
+                return false;
+            }
+            else
+            {
+                pos = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    [[nodiscard]] bool try_push(T&& value)
+    {
+        return try_emplace(std::move(value));
+    }
+
+    [[nodiscard]] bool try_push(const T& value)
+    {
+        return try_emplace(value);
+    }
+
+    [[nodiscard]] std::optional<T> try_pop()
+    {
+        std::size_t pos = m_dequeue.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell      = m_cells[pos & m_mask];
+            const auto diff = static_cast<std::ptrdiff_t>(cell.sequence.load(std::memory_order_acquire) - (pos + 1));
+            if (diff == 0)
+            {
+                if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    return take(cell, pos);
+                }
+            }
+            else if (diff < 0)
+            {
+                return std::nullopt;
+            }
+            else
+            {
+                pos = m_dequeue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Move up to `count` elements from `first` into the ring with a single claim of the producer index and return
+    // how many were taken. A run of free cells can't change hands until the index moves past it, which is why
+    // checking the cells before the CAS is enough.
+    template <typename Iterator>
+    std::size_t try_push_bulk(Iterator first, std::size_t count)
+    {
+        count           = std::min(count, capacity());
+        std::size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        while (true)
+        {
+            std::size_t free = 0;
+            while (free < count && m_cells[(pos + free) & m_mask].sequence.load(std::memory_order_acquire) ==
+                                       pos + free)
+            {
+                ++free;
+            }
+            if (free == 0)
+            {
+                const std::size_t current = m_enqueue.load(std::memory_order_relaxed);
+                if (current == pos)
+                {
+                    return 0;
+                }
+                pos = current;
+                continue;
+            }
+
+            if (m_enqueue.compare_exchange_weak(pos, pos + free, std::memory_order_relaxed))
+            {
+                for (std::size_t i = 0; i < free; ++i, ++first)
+                {
+                    Cell& cell = m_cells[(pos + i) & m_mask];
+                    ::new (static_cast<void*>(cell.storage)) T(std::move(*first));
+                    cell.sequence.store(pos + i + 1, std::memory_order_release);
+                }
+                return free;
+            }
+        }
+    }
+
+    // Pop up to `count` elements into `out` with a single claim of the consumer index, returns how many.
+    template <typename OutputIterator>
+    std::size_t try_pop_bulk(OutputIterator out, std::size_t count)
+    {
+        count           = std::min(count, capacity());
+        std::size_t pos = m_dequeue.load(std::memory_order_relaxed);
+        while (true)
+        {
+            std::size_t full = 0;
+            while (full < count && m_cells[(pos + full) & m_mask].sequence.load(std::memory_order_acquire) ==
+                                       pos + full + 1)
+            {
+                ++full;
+            }
+            if (full == 0)
+            {
+                const std::size_t current = m_dequeue.load(std::memory_order_relaxed);
+                if (current == pos)
+                {
+                    return 0;
+                }
+                pos = current;
+                continue;
+            }
+
+            if (m_dequeue.compare_exchange_weak(pos, pos + full, std::memory_order_relaxed))
+            {
+                for (std::size_t i = 0; i < full; ++i, ++out)
+                {
+                    *out = take(m_cells[(pos + i) & m_mask], pos + i);
+                }
+                return full;
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // approximate while other threads are pushing or popping
+    [[nodiscard]] std::size_t size() const
+    {
+        const std::size_t dequeue = m_dequeue.load(std::memory_order_relaxed);
+        const std::size_t enqueue = m_enqueue.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    T take(Cell& cell, std::size_t pos)
+    {
+        T value = std::move(*cell.value());
+        cell.value()->~T();
+        // free for the producer of the next lap
+        cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return value;
+    }
+
+    const std::size_t m_mask;
+    const std::unique_ptr<Cell[]> m_cells;
+    alignas(CacheLineSize) std::atomic<std::size_t> m_enqueue{ 0 };
+    alignas(CacheLineSize) std::atomic<std::size_t> m_dequeue{ 0 };
+};
+
+} // namespace ana
@@ -0,0 +1,471 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Parallel algorithms on top of ThreadPool::parallelFor(). Every call blocks until done, the calling thread works on
+// the first chunk and then helps draining the pool, so they may be used from workers as well. Inputs too small to
+// be worth splitting run serially on the caller.
+//
+//   ana::parallel::transform(pool, positions.begin(), positions.end(), out.begin(), project);
+//   auto bounds = ana::parallel::reduce(pool, boxes.begin(), boxes.end(), Aabb{}, merge);
+//   ana::parallel::sort(pool, drawKeys.begin(), drawKeys.end());
+namespace ana::parallel
+{
+
+// fewest elements worth a chunk of their own for cheap per-element work
+inline constexpr std::size_t DefaultMinGrain = 2048;
+
+namespace detail
+{
+// Adaptive partition: enough chunks for load balancing (4 per worker) but never below `minGrain` elements each.
+struct Partition
+{
+    std::size_t size   = 0;
+    std::size_t chunks = 1;
+    std::size_t grain  = 0;
+
+    Partition(std::size_t count, std::size_t workers, std::size_t minGrain)
+        : size(count)
+    {
+        const std::size_t maxChunks = std::max<std::size_t>(1, workers * 4);
+        chunks                      = std::clamp<std::size_t>(count / std::max<std::size_t>(1, minGrain), 1, maxChunks);
+        grain                       = (count + chunks - 1) / chunks;
+        if (grain != 0)
+        {
+            chunks = (count + grain - 1) / grain;
+        }
+    }
+
+    [[nodiscard]] std::size_t begin(std::size_t chunk) const
+    {
+        return std::min(chunk * grain, size);
+    }
+
+    [[nodiscard]] std::size_t end(std::size_t chunk) const
+    {
+        return std::min((chunk + 1) * grain, size);
+    }
+};
+
+// run fn(chunk) for every chunk of `part`, on the caller alone if there is only one
+template <typename Pool, typename Function>
+void forChunks(Pool& pool, const Partition& part, Function&& fn)
+{
+    if (part.chunks <= 1)
+    {
+        if (part.size != 0)
+        {
+            fn(std::size_t{ 0 });
+        }
+        return;
+    }
+    pool.parallelFor(std::size_t{ 0 }, part.chunks, std::size_t{ 1 }, fn);
+}
+
+// Number of elements of `a` among the first `k` elements of the stable merge of a and b (merge path co-rank).
+template <typename It, typename Compare>
+std::size_t coRank(std::size_t k, It a, std::size_t m, It b, std::size_t n, Compare& comp)
+{
+    std::size_t lo = k > n ? k - n : 0;
+    std::size_t hi = std::min(k, m);
+    while (lo < hi)
+    {
+        const std::size_t i = lo + (hi - lo) / 2;
+        const std::size_t j = k - i;
+        // std::merge takes from `a` on ties, so a[i] goes first unless b[j - 1] is strictly smaller
+        if (i < m && j > 0 && !comp(b[j - 1], a[i]))
+        {
+            lo = i + 1;
+        }
+        else
+        {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+template <typename T>
+concept RadixKey = std::integral<T> && !std::same_as<T, bool>;
+
+// parallel std::move of [first, first + part.size) to out
+template <typename Pool, typename InputIt, typename OutputIt>
+void moveChunks(Pool& pool, const Partition& part, InputIt first, OutputIt out)
+{
+    forChunks(pool, part,
+              [&](std::size_t chunk)
+              {
+                  const auto from = static_cast<std::ptrdiff_t>(part.begin(chunk));
+                  const auto to   = static_cast<std::ptrdiff_t>(part.end(chunk));
+                  std::move(first + from, first + to, out + from);
+              });
+}
+
+// order preserving mapping of a radix key to an unsigned integer
+template <RadixKey T>
+auto radixBits(T value)
+{
+    using Unsigned = std::make_unsigned_t<T>;
+    auto bits      = static_cast<Unsigned>(value);
+    if constexpr (std::is_signed_v<T>)
+    {
+        bits ^= Unsigned{ 1 } << (sizeof(T) * 8 - 1);
+    }
+    return bits;
+}
+} // namespace detail
+
+// fn(i) for every i in [begin, end)
+template <typename Pool, std::integral Index, typename Function>
+    requires std::invocable<Function&, Index>
+void forEach(Pool& pool, Index begin, Index end, Function&& fn, std::size_t minGrain = DefaultMinGrain)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+    const detail::Partition part(static_cast<std::size_t>(end - begin), pool.size(), minGrain);
+    detail::forChunks(pool, part,
+                      [&](std::size_t chunk)
+                      {
+                          const Index last = begin + static_cast<Index>(part.end(chunk));
+                          for (Index i = begin + static_cast<Index>(part.begin(chunk)); i != last; ++i)
+                          {
+                              fn(i);
+                          }
+                      });
+}
+
+template <typename Pool, std::random_access_iterator InputIt, std::random_access_iterator OutputIt,
+          typename UnaryOp>
+OutputIt transform(Pool& pool, InputIt first, InputIt last, OutputIt out, UnaryOp op,
+                   std::size_t minGrain = DefaultMinGrain)
+{
+    const detail::Partition part(static_cast<std::size_t>(last - first), pool.size(), minGrain);
+    detail::forChunks(pool, part,
+                      [&](std::size_t chunk)
+                      {
+                          const auto from = static_cast<std::ptrdiff_t>(part.begin(chunk));
+                          const auto to   = static_cast<std::ptrdiff_t>(part.end(chunk));
+                          std::transform(first + from, first + to, out + from, op);
+                      });
+    return out + (last - first);
+}
+
+// `op` has to be associative, it is not assumed to be commutative: partial results are combined in order.
+template <typename Pool, std::random_access_iterator It, typename T, typename BinaryOp = std::plus<>>
+T reduce(Pool& pool, It first, It last, T init, BinaryOp op = {}, std::size_t minGrain = DefaultMinGrain)
+{
+    const detail::Partition part(static_cast<std::size_t>(last - first), pool.size(), minGrain);
+    if (part.chunks <= 1)
+    {
+        return std::accumulate(first, last, std::move(init), op);
+    }
+
+    std::vector<std::optional<T>> partials(part.chunks);
+    detail::forChunks(pool, part,
+                      [&](std::size_t chunk)
+                      {
+                          auto from = first + static_cast<std::ptrdiff_t>(part.begin(chunk));
+                          auto to   = first + static_cast<std::ptrdiff_t>(part.end(chunk));
+                          T value   = *from;
+                          partials[chunk].emplace(std::accumulate(++from, to, std::move(value), op));
+                      });
+
+    for (auto& partial : partials)
+    {
+        init = op(std::move(init), std::move(*partial));
+    }
+    return init;
+}
+
+// Inclusive prefix scan in two passes: per-chunk totals, a serial scan over the chunk totals, then every chunk
+// scans again seeded with the total of everything before it. `out` may be `first`.
+template <typename Pool, std::random_access_iterator InputIt, std::random_access_iterator OutputIt,
+          typename BinaryOp = std::plus<>>
+OutputIt inclusiveScan(Pool& pool, InputIt first, InputIt last, OutputIt out, BinaryOp op = {},
+                       std::size_t minGrain = DefaultMinGrain)
+{
+    using T = typename std::iterator_traits<InputIt>::value_type;
+
+    const detail::Partition part(static_cast<std::size_t>(last - first), pool.size(), minGrain);
+    if (part.chunks <= 1)
+    {
+        return std::inclusive_scan(first, last, out, op);
+    }
+
+    std::vector<std::optional<T>> carry(part.chunks);
+    detail::forChunks(pool, part,
+                      [&](std::size_t chunk)
+                      {
+                          // the last chunk's total is never needed
+                          if (chunk + 1 == part.chunks)
+                          {
+                              return;
+                          }
+                          auto from = first + static_cast<std::ptrdiff_t>(part.begin(chunk));
+                          auto to   = first + static_cast<std::ptrdiff_t>(part.end(chunk));
+                          T value   = *from;
+                          carry[chunk].emplace(std::accumulate(++from, to, std::move(value), op));
+                      });
+
+    // carry[c] becomes the total of all chunks before c
+    std::optional<T> running;
+    for (auto& total : carry)
+    {
+        auto next = std::move(total);
+        total     = running;
+        if (next)
+        {
+            running = running ? op(std::move(*running), std::move(*next)) : std::move(next);
+        }
+    }
+
+    detail::forChunks(pool, part,
+                      [&](std::size_t chunk)
+                      {
+                          const auto from = static_cast<std::ptrdiff_t>(part.begin(chunk));
+                          const auto to   = static_cast<std::ptrdiff_t>(part.end(chunk));
+                          if (carry[chunk])
+                          {
+                              std::inclusive_scan(first + from, first + to, out + from, op, *carry[chunk]);
+                          }
+                          else
+                          {
+                              std::inclusive_scan(first + from, first + to, out + from, op);
+                          }
+                      });
+    return out + (last - first);
+}
+
+// out[i] = init op first[0] op ... op first[i - 1]. Unlike inclusiveScan `out` must not alias the input.
+template <typename Pool, std::random_access_iterator InputIt, std::random_access_iterator OutputIt, typename T,
+          typename BinaryOp = std::plus<>>
+OutputIt exclusiveScan(Pool& pool, InputIt first, InputIt last, OutputIt out, T init, BinaryOp op = {},
+                       std::size_t minGrain = DefaultMinGrain)
+{
+    const auto count = last - first;
+    if (count == 0)
+    {
+        return out;
+    }
+    *out = init;
+    if (count > 1)
+    {
+        inclusiveScan(pool, first, last - 1, out + 1, op, minGrain);
+        transform(
+            pool, out + 1, out + count, out + 1,
+            [&](const auto& value)
+            {
+                return op(init, value);
+            },
+            minGrain);
+    }
+    return out + count;
+}
+
+// Stable LSD radix sort over 8 bit digits for integer keys. Each pass counts digits per chunk in parallel,
+// turns the counts into per-chunk output offsets and scatters in parallel; passes where every key has the same
+// digit are skipped.
+template <typename Pool, std::random_access_iterator It>
+    requires detail::RadixKey<typename std::iterator_traits<It>::value_type>
+void radixSort(Pool& pool, It first, It last, std::size_t minGrain = DefaultMinGrain)
+{
+    using T                       = typename std::iterator_traits<It>::value_type;
+    constexpr int Bits            = 8;
+    constexpr std::size_t Buckets = std::size_t{ 1 } << Bits;
+
+    const auto count = static_cast<std::size_t>(last - first);
+    const detail::Partition part(count, pool.size(), minGrain);
+    if (part.chunks <= 1)
+    {
+        std::stable_sort(first, last);
+        return;
+    }
+
+    // contiguous input is sorted in place, ping-ponging with one scratch buffer
+    std::vector<T> buffer(count);
+    std::vector<T> keys;
+    T* data = nullptr;
+    if constexpr (std::contiguous_iterator<It>)
+    {
+        data = std::to_address(first);
+    }
+    else
+    {
+        keys.assign(first, last);
+        data = keys.data();
+    }
+    T* src = data;
+    T* dst = buffer.data();
+    std::vector<std::array<std::size_t, Buckets>> offsets(part.chunks);
+
+    for (std::size_t shift = 0; shift < sizeof(T) * 8; shift += Bits)
+    {
+        detail::forChunks(pool, part,
+                          [&](std::size_t chunk)
+                          {
+                              auto& histogram = offsets[chunk];
+                              histogram.fill(0);
+                              for (std::size_t i = part.begin(chunk); i < part.end(chunk); ++i)
+                              {
+                                  ++histogram[(detail::radixBits(src[i]) >> shift) & (Buckets - 1)];
+                              }
+                          });
+
+        // digit-major, chunk-minor prefix sum keeps the sort stable
+        std::size_t running = 0;
+        bool trivial        = false;
+        for (std::size_t digit = 0; digit < Buckets && !trivial; ++digit)
+        {
+            std::size_t digitTotal = 0;
+            for (auto& histogram : offsets)
+            {
+                const std::size_t n = histogram[digit];
+                histogram[digit]    = running;
+                running += n;
+                digitTotal += n;
+            }
+            trivial = digitTotal == count;
+        }
+        if (trivial)
+        {
+            continue;
+        }
+
+        detail::forChunks(pool, part,
+                          [&](std::size_t chunk)
+                          {
+                              auto& offset = offsets[chunk];
+                              for (std::size_t i = part.begin(chunk); i < part.end(chunk); ++i)
+                              {
+                                  dst[offset[(detail::radixBits(src[i]) >> shift) & (Buckets - 1)]++] = src[i];
+                              }
+                          });
+        std::swap(src, dst);
+    }
+
+    if (src != data || !std::contiguous_iterator<It>)
+    {
+        detail::moveChunks(pool, part, src, first);
+    }
+}
+
+// Stable parallel merge sort: chunks are sorted independently, then merged pairwise in rounds. Each merge is split
+// further along its merge path so that the last rounds, with only a few big merges left, still use every worker.
+// Needs a default constructible, move assignable value type for the scratch buffer.
+template <typename Pool, std::random_access_iterator It, typename Compare = std::less<>>
+void mergeSort(Pool& pool, It first, It last, Compare comp = {}, std::size_t minGrain = DefaultMinGrain)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+
+    const auto count = static_cast<std::size_t>(last - first);
+    const detail::Partition part(count, pool.size(), minGrain);
+    if (part.chunks <= 1)
+    {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+
+    detail::forChunks(pool, part,
+                      [&](std::size_t chunk)
+                      {
+                          std::stable_sort(first + static_cast<std::ptrdiff_t>(part.begin(chunk)),
+                                           first + static_cast<std::ptrdiff_t>(part.end(chunk)), comp);
+                      });
+
+    std::vector<T> buffer(count);
+    bool inBuffer = false;
+    for (std::size_t width = part.grain; width < count; width *= 2)
+    {
+        const std::size_t pairs  = (count + 2 * width - 1) / (2 * width);
+        const std::size_t pieces = (part.chunks + pairs - 1) / pairs;
+        // one chunk per merge piece
+        const detail::Partition tasks(pairs * pieces, pairs * pieces, 1);
+
+        // split points along each merge path, all taken before any piece starts moving elements out of src
+        std::vector<std::size_t> splits(pairs * (pieces + 1));
+        auto mergeRound = [&](auto src, auto dst)
+        {
+            const auto at = [](auto base, std::size_t offset)
+            {
+                return base + static_cast<std::ptrdiff_t>(offset);
+            };
+            for (std::size_t pair = 0; pair < pairs; ++pair)
+            {
+                const std::size_t lo  = pair * 2 * width;
+                const std::size_t mid = std::min(lo + width, count);
+                const std::size_t hi  = std::min(lo + 2 * width, count);
+                for (std::size_t piece = 0; piece <= pieces; ++piece)
+                {
+                    const std::size_t k = (hi - lo) * piece / pieces;
+                    splits[pair * (pieces + 1) + piece] =
+                        detail::coRank(k, at(src, lo), mid - lo, at(src, mid), hi - mid, comp);
+                }
+            }
+
+            detail::forChunks(pool, tasks,
+                              [&](std::size_t task)
+                              {
+                                  const std::size_t pair  = task / pieces;
+                                  const std::size_t piece = task % pieces;
+                                  const std::size_t lo    = pair * 2 * width;
+                                  const std::size_t mid   = std::min(lo + width, count);
+                                  const std::size_t hi    = std::min(lo + 2 * width, count);
+                                  const std::size_t k0    = (hi - lo) * piece / pieces;
+                                  const std::size_t k1    = (hi - lo) * (piece + 1) / pieces;
+                                  const std::size_t i0    = splits[pair * (pieces + 1) + piece];
+                                  const std::size_t i1    = splits[pair * (pieces + 1) + piece + 1];
+                                  std::merge(std::make_move_iterator(at(src, lo + i0)),
+                                             std::make_move_iterator(at(src, lo + i1)),
+                                             std::make_move_iterator(at(src, mid + k0 - i0)),
+                                             std::make_move_iterator(at(src, mid + k1 - i1)), at(dst, lo + k0), comp);
+                              });
+        };
+
+        if (inBuffer)
+        {
+            mergeRound(buffer.begin(), first);
+        }
+        else
+        {
+            mergeRound(first, buffer.begin());
+        }
+        inBuffer = !inBuffer;
+    }
+
+    if (inBuffer)
+    {
+        detail::moveChunks(pool, part, buffer.begin(), first);
+    }
+}
+
+// Radix sort for integer keys in ascending order, merge sort for everything else. Both are stable.
+template <typename Pool, std::random_access_iterator It, typename Compare = std::less<>>
+void sort(Pool& pool, It first, It last, Compare comp = {}, std::size_t minGrain = DefaultMinGrain)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    constexpr bool ascending = std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<T>>;
+    if constexpr (detail::RadixKey<T> && ascending)
+    {
+        radixSort(pool, first, last, minGrain);
+    }
+    else
+    {
+        mergeSort(pool, first, last, comp, minGrain);
+    }
+}
+
+} // namespace ana::parallel
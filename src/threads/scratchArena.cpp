@@ -0,0 +1,166 @@
+#include "scratchArena.h"
+
+#include <algorithm>
+
+namespace ana
+{
+
+namespace
+{
+thread_local ScratchArena* tls_bound = nullptr;
+
+ScratchArena& ownScratch()
+{
+    static thread_local ScratchArena s_arena;
+    return s_arena;
+}
+
+std::size_t alignUp(std::size_t value, std::size_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+} // namespace
+
+ScratchArena& threads::scratch()
+{
+    return tls_bound ? *tls_bound : ownScratch();
+}
+
+void threads::bindScratch(ScratchArena* arena)
+{
+    tls_bound = arena;
+}
+
+ScratchArena::ScratchArena(std::size_t blockSize, std::size_t oversizeLimit)
+    : m_blockSize(std::max<std::size_t>(blockSize, BlockAlign))
+    , m_oversizeLimit(oversizeLimit ? std::min(oversizeLimit, m_blockSize) : m_blockSize / 4)
+{
+}
+
+ScratchArena::~ScratchArena()
+{
+    freeOversize(nullptr);
+    releaseBlocks();
+}
+
+void ScratchArena::reserve(std::size_t bytes)
+{
+    bytes = std::max(bytes, m_blockSize);
+    if (!m_blocks.empty() && (m_blocks.front().size >= bytes || used() != 0 || m_oversize))
+    {
+        // big enough already, or memory is handed out and can't move
+        return;
+    }
+    releaseBlocks();
+    m_blocks.push_back({ static_cast<std::byte*>(::operator new(bytes, std::align_val_t{ BlockAlign })), bytes });
+    m_capacity.store(bytes, std::memory_order_relaxed);
+}
+
+void ScratchArena::reset()
+{
+    freeOversize(nullptr);
+    if (m_blocks.size() > 1)
+    {
+        std::size_t total = 0;
+        for (const auto& block : m_blocks)
+        {
+            total += block.size;
+        }
+        releaseBlocks();
+        reserve(total);
+    }
+    m_current    = 0;
+    m_offset     = 0;
+    m_usedBefore = 0;
+}
+
+void ScratchArena::rewind(const Marker& marker)
+{
+    freeOversize(marker.oversize);
+    m_usedBefore = 0;
+    for (std::size_t i = 0; i < marker.block && i < m_blocks.size(); ++i)
+    {
+        m_usedBefore += m_blocks[i].size;
+    }
+    m_current = marker.block;
+    m_offset  = marker.offset;
+}
+
+ScratchStats ScratchArena::stats() const
+{
+    ScratchStats stats{};
+    stats.capacity            = m_capacity.load(std::memory_order_relaxed);
+    stats.peakBytes           = m_peak.load(std::memory_order_relaxed);
+    stats.oversizeAllocations = m_oversizeCount.load(std::memory_order_relaxed);
+    stats.blockAllocations    = m_blockCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ScratchArena::resetPeak()
+{
+    m_peak.store(0, std::memory_order_relaxed);
+    m_oversizeCount.store(0, std::memory_order_relaxed);
+    m_blockCount.store(0, std::memory_order_relaxed);
+}
+
+void* ScratchArena::allocateSlow(std::size_t bytes, std::size_t align)
+{
+    if (bytes > m_oversizeLimit || align > BlockAlign)
+    {
+        // the header sits right in front of the returned memory
+        align                    = std::max(align, alignof(Oversize));
+        const std::size_t header = alignUp(sizeof(Oversize), align);
+        auto* base               = static_cast<std::byte*>(::operator new(header + bytes, std::align_val_t{ align }));
+        m_oversize               = ::new (base) Oversize{ m_oversize, header + bytes, align };
+        m_oversizeCount.fetch_add(1, std::memory_order_relaxed);
+        return base + header;
+    }
+
+    while (true)
+    {
+        if (m_current < m_blocks.size())
+        {
+            const std::size_t offset = alignUp(m_offset, align);
+            if (offset + bytes <= m_blocks[m_current].size)
+            {
+                m_offset = offset + bytes;
+                notePeak();
+                return m_blocks[m_current].data + offset;
+            }
+            // the rest of this block is wasted until the next reset or rewind
+            m_usedBefore += m_blocks[m_current].size;
+            ++m_current;
+            m_offset = 0;
+        }
+        if (m_current == m_blocks.size())
+        {
+            // every block is at least m_blockSize and so fits any non-oversize request
+            auto* data = static_cast<std::byte*>(::operator new(m_blockSize, std::align_val_t{ BlockAlign }));
+            m_blocks.push_back({ data, m_blockSize });
+            m_capacity.fetch_add(m_blockSize, std::memory_order_relaxed);
+            m_blockCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void ScratchArena::freeOversize(Oversize* until)
+{
+    while (m_oversize != until)
+    {
+        Oversize* node = m_oversize;
+        m_oversize     = node->next;
+        ::operator delete(node, node->bytes, std::align_val_t{ node->align });
+    }
+}
+
+void ScratchArena::releaseBlocks()
+{
+    for (const auto& block : m_blocks)
+    {
+        ::operator delete(block.data, block.size, std::align_val_t{ BlockAlign });
+    }
+    m_blocks.clear();
+    m_capacity.store(0, std::memory_order_relaxed);
+}
+
+} // namespace ana
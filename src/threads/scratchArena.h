@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace ana
+{
+
+struct ScratchStats
+{
+    // bytes reserved in blocks, oversize allocations not included
+    std::size_t capacity = 0;
+    // most bytes in use at once since construction or the last resetPeak()
+    std::size_t peakBytes = 0;
+    // allocations above the oversize limit that went to the global heap
+    std::uint64_t oversizeAllocations = 0;
+    // blocks allocated because the current ones ran out, 0 in steady state
+    std::uint64_t blockAllocations = 0;
+};
+
+// Bump-pointer arena for short-lived temporaries. Allocation is a pointer bump in the current block; memory is only
+// given back all at once by reset() or by rewinding to a Marker (see ScratchScope). When a frame needed more than
+// one block, reset() replaces them with a single block of the combined size so the next frame doesn't allocate.
+// Requests above the oversize limit go to the global heap and are freed on reset/rewind.
+//
+// Single-threaded: an arena belongs to one thread, stats() is the only call that is safe from any thread.
+class ScratchArena
+{
+    struct Oversize
+    {
+        Oversize* next;
+        std::size_t bytes;
+        std::size_t align;
+    };
+
+public:
+    static constexpr std::size_t DefaultBlockSize = 256 * 1024;
+
+    // where a rewind goes back to
+    struct Marker
+    {
+        std::size_t block;
+        std::size_t offset;
+        Oversize* oversize;
+    };
+
+    // Nothing is allocated until the first request or reserve(). Requests above oversizeLimit (default: a quarter
+    // of the block size) bypass the blocks.
+    explicit ScratchArena(std::size_t blockSize = DefaultBlockSize, std::size_t oversizeLimit = 0);
+    ~ScratchArena();
+
+    ScratchArena(const ScratchArena&)            = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    [[nodiscard]] void* allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t))
+    {
+        if (bytes <= m_oversizeLimit && align <= BlockAlign && m_current < m_blocks.size())
+        {
+            const std::size_t offset = (m_offset + align - 1) & ~(align - 1);
+            if (offset + bytes <= m_blocks[m_current].size)
+            {
+                m_offset = offset + bytes;
+                notePeak();
+                return m_blocks[m_current].data + offset;
+            }
+        }
+        return allocateSlow(bytes, align);
+    }
+
+    template <typename T>
+    [[nodiscard]] T* allocate(std::size_t count)
+    {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Only the most recent allocation is actually given back, which is what a growing vector needs. Anything else
+    // stays in use until reset() or rewind().
+    void deallocate(void* ptr, std::size_t bytes)
+    {
+        if (m_current < m_blocks.size() && static_cast<std::byte*>(ptr) + bytes == m_blocks[m_current].data + m_offset)
+        {
+            m_offset -= bytes;
+        }
+    }
+
+    // make sure the first block holds at least `bytes`
+    void reserve(std::size_t bytes);
+
+    // Give everything back. Invalidates all memory handed out so far.
+    void reset();
+
+    [[nodiscard]] Marker mark() const
+    {
+        return { m_current, m_offset, m_oversize };
+    }
+
+    // Give back everything allocated after `marker` was taken. Markers must be rewound in LIFO order.
+    void rewind(const Marker& marker);
+
+    // bytes in use right now, owner thread only
+    [[nodiscard]] std::size_t used() const
+    {
+        return m_usedBefore + m_offset;
+    }
+
+    [[nodiscard]] ScratchStats stats() const;
+    void resetPeak();
+
+private:
+    static constexpr std::size_t BlockAlign = 64;
+
+    struct Block
+    {
+        std::byte* data;
+        std::size_t size;
+    };
+
+    void notePeak()
+    {
+        const std::size_t bytes = m_usedBefore + m_offset;
+        if (bytes > m_peak.load(std::memory_order_relaxed))
+        {
+            m_peak.store(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void* allocateSlow(std::size_t bytes, std::size_t align);
+    void freeOversize(Oversize* until);
+    void releaseBlocks();
+
+    const std::size_t m_blockSize;
+    const std::size_t m_oversizeLimit;
+    std::vector<Block> m_blocks;
+    std::size_t m_current = 0;
+    std::size_t m_offset  = 0;
+    // sizes of the blocks before m_current, they count as used
+    std::size_t m_usedBefore = 0;
+    Oversize* m_oversize     = nullptr;
+    // read by stats() from other threads
+    std::atomic_size_t m_capacity{ 0 };
+    std::atomic_size_t m_peak{ 0 };
+    std::atomic_uint64_t m_oversizeCount{ 0 };
+    std::atomic_uint64_t m_blockCount{ 0 };
+};
+
+// Rewinds the arena to where it was on construction, e.g. around a task group whose temporaries die with it.
+class ScratchScope
+{
+public:
+    explicit ScratchScope(ScratchArena& arena)
+        : m_arena(arena)
+        , m_marker(arena.mark())
+    {
+    }
+
+    ~ScratchScope()
+    {
+        m_arena.rewind(m_marker);
+    }
+
+    ScratchScope(const ScratchScope&)            = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    [[nodiscard]] ScratchArena& arena() const
+    {
+        return m_arena;
+    }
+
+private:
+    ScratchArena& m_arena;
+    ScratchArena::Marker m_marker;
+};
+
+// std allocator on top of a ScratchArena, e.g. std::vector<int, ScratchAllocator<int>> v(threads::scratch());
+template <typename T>
+class ScratchAllocator
+{
+public:
+    using value_type = T;
+
+    ScratchAllocator(ScratchArena& arena) noexcept
+        : m_arena(&arena)
+    {
+    }
+
+    template <typename U>
+    ScratchAllocator(const ScratchAllocator<U>& other) noexcept
+        : m_arena(&other.arena())
+    {
+    }
+
+    [[nodiscard]] T* allocate(std::size_t count)
+    {
+        return m_arena->allocate<T>(count);
+    }
+
+    void deallocate(T* ptr, std::size_t count) noexcept
+    {
+        m_arena->deallocate(ptr, count * sizeof(T));
+    }
+
+    [[nodiscard]] ScratchArena& arena() const noexcept
+    {
+        return *m_arena;
+    }
+
+    template <typename U>
+    bool operator==(const ScratchAllocator<U>& other) const noexcept
+    {
+        return m_arena == &other.arena();
+    }
+
+private:
+    ScratchArena* m_arena;
+};
+
+namespace threads
+{
+// The calling thread's scratch arena: the worker's own arena inside a ThreadPool task, otherwise one created on
+// first use for this thread. Memory from it must not outlive the current frame (see ThreadPool::resetScratch())
+// and must not be handed to other threads that keep it past that.
+ScratchArena& scratch();
+
+// Make `arena` what scratch() returns on this thread, nullptr goes back to the thread's own arena. Used by the
+// pool workers.
+void bindScratch(ScratchArena* arena);
+} // namespace threads
+
+} // namespace ana
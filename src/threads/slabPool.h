@@ -0,0 +1,201 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace ana
+{
+
+// Thread-safe pool of fixed-size blocks. Blocks are carved out of slabs that double in size and are only returned
+// to the system when the pool dies, so once warmed up allocate()/deallocate() never touch the global heap.
+// The free list is a Treiber stack over 32-bit block indices tagged with a 32-bit counter against ABA.
+template <std::size_t BlockSize, std::size_t BlockAlign = alignof(std::max_align_t)>
+class SlabPool
+{
+    struct alignas(BlockAlign) Block
+    {
+        alignas(BlockAlign) std::byte storage[BlockSize];
+        std::atomic<std::uint32_t> next{ Nil };
+        std::uint32_t index = 0;
+    };
+
+    static constexpr std::uint32_t Nil        = ~0u;
+    static constexpr std::uint32_t FirstSlab  = 64;
+    static constexpr std::size_t MaxSlabCount = 26;
+
+public:
+    SlabPool() = default;
+
+    ~SlabPool()
+    {
+        for (auto& slab : m_slabs)
+        {
+            delete[] slab.load(std::memory_order_relaxed);
+        }
+    }
+
+    SlabPool(const SlabPool&)            = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    [[nodiscard]] void* allocate()
+    {
+        std::uint64_t head = m_head.load(std::memory_order_acquire);
+        while (true)
+        {
+            const auto index = static_cast<std::uint32_t>(head);
+            if (index == Nil)
+            {
+                grow();
+                head = m_head.load(std::memory_order_acquire);
+                continue;
+            }
+
+            Block* block                = blockAt(index);
+            const std::uint32_t next    = block->next.load(std::memory_order_relaxed);
+            const std::uint64_t desired = pack(tag(head) + 1, next);
+            if (m_head.compare_exchange_weak(head, desired, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                return block->storage;
+            }
+        }
+    }
+
+    void deallocate(void* ptr)
+    {
+        push(toBlock(ptr)->index, toBlock(ptr));
+    }
+
+    // Collects blocks and gives them back in one piece when flushed or destroyed: one atomic operation for the
+    // whole lot instead of one per block. Single-threaded, one chain per releasing thread.
+    class FreeChain
+    {
+    public:
+        explicit FreeChain(SlabPool& pool)
+            : m_pool(pool)
+        {
+        }
+
+        ~FreeChain()
+        {
+            flush();
+        }
+
+        FreeChain(const FreeChain&)            = delete;
+        FreeChain& operator=(const FreeChain&) = delete;
+
+        void add(void* ptr)
+        {
+            Block* block = toBlock(ptr);
+            if (m_last)
+            {
+                block->next.store(m_first, std::memory_order_relaxed);
+            }
+            else
+            {
+                m_last = block;
+            }
+            m_first = block->index;
+        }
+
+        void flush()
+        {
+            if (m_last)
+            {
+                m_pool.push(m_first, m_last);
+                m_last = nullptr;
+            }
+        }
+
+    private:
+        SlabPool& m_pool;
+        std::uint32_t m_first = Nil;
+        // the block added first, the end of the chain
+        Block* m_last = nullptr;
+    };
+
+    // blocks currently carved out of slabs, free or not
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return m_capacity.load(std::memory_order_relaxed);
+    }
+
+private:
+    static Block* toBlock(void* ptr)
+    {
+        // storage is the first member of Block
+        return reinterpret_cast<Block*>(ptr);
+    }
+
+    static std::uint64_t pack(std::uint32_t counter, std::uint32_t index)
+    {
+        return (static_cast<std::uint64_t>(counter) << 32) | index;
+    }
+
+    static std::uint32_t tag(std::uint64_t head)
+    {
+        return static_cast<std::uint32_t>(head >> 32);
+    }
+
+    // slab k holds FirstSlab << k blocks and starts at index FirstSlab * (2^k - 1)
+    Block* blockAt(std::uint32_t index) const
+    {
+        const std::uint32_t bucket = index / FirstSlab + 1;
+        const auto slab            = static_cast<std::uint32_t>(std::bit_width(bucket) - 1);
+        const std::uint32_t offset = index - FirstSlab * ((1u << slab) - 1);
+        return m_slabs[slab].load(std::memory_order_acquire) + offset;
+    }
+
+    // push the already linked chain that starts at `first` and ends with `lastBlock`
+    void push(std::uint32_t first, Block* lastBlock)
+    {
+        std::uint64_t head = m_head.load(std::memory_order_relaxed);
+        do
+        {
+            lastBlock->next.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+        } while (!m_head.compare_exchange_weak(head, pack(tag(head) + 1, first), std::memory_order_release,
+                                               std::memory_order_relaxed));
+    }
+
+    void grow()
+    {
+        std::scoped_lock lk(m_growMutex);
+        if (static_cast<std::uint32_t>(m_head.load(std::memory_order_acquire)) != Nil)
+        {
+            // somebody else refilled the free list meanwhile
+            return;
+        }
+
+        const std::size_t slab = m_slabCount;
+        if (slab == MaxSlabCount)
+        {
+            throw std::bad_alloc();
+        }
+
+        const std::uint32_t count = FirstSlab << slab;
+        const std::uint32_t base  = FirstSlab * ((1u << slab) - 1);
+        auto* blocks              = new Block[count];
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            blocks[i].index = base + i;
+            blocks[i].next.store(base + i + 1, std::memory_order_relaxed);
+        }
+        m_slabs[slab].store(blocks, std::memory_order_release);
+        ++m_slabCount;
+        m_capacity.fetch_add(count, std::memory_order_relaxed);
+
+        push(base, &blocks[count - 1]);
+    }
+
+    std::atomic<std::uint64_t> m_head{ Nil };
+    std::array<std::atomic<Block*>, MaxSlabCount> m_slabs{};
+    std::size_t m_slabCount = 0;
+    std::atomic<std::size_t> m_capacity{ 0 };
+    std::mutex m_growMutex;
+};
+
+} // namespace ana
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "workStealingDeque.h"
+
+namespace ana
+{
+
+// Bounded wait-free single-producer single-consumer queue. Each side keeps a cached copy of the other side's index
+// and only reloads it when the cached value says full/empty, so in steady state producer and consumer don't touch
+// each other's cache lines at all. Exactly one thread may push and exactly one (other) thread may pop.
+template <typename T>
+    requires std::is_nothrow_move_constructible_v<T>
+class SpscRing
+{
+    struct Slot
+    {
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* value()
+        {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    // capacity is rounded up to a power of two
+    explicit SpscRing(std::size_t capacity)
+        : m_mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1)
+        , m_slots(std::make_unique<Slot[]>(m_mask + 1))
+    {
+    }
+
+    ~SpscRing()
+    {
+        while (try_pop())
+        {
+        }
+    }
+
+    SpscRing(const SpscRing&)            = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    template <typename... Args>
+    [[nodiscard]] bool try_emplace(Args&&... args)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache == capacity())
+        {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache == capacity())
+            {
+                return false;
+            }
+        }
+        ::new (static_cast<void*>(m_slots[tail & m_mask].storage)) T(std::forward<Args>(args)...);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool try_push(T&& value)
+    {
+        return try_emplace(std::move(value));
+    }
+
+    [[nodiscard]] bool try_push(const T& value)
+    {
+        return try_emplace(value);
+    }
+
+    [[nodiscard]] std::optional<T> try_pop()
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache)
+        {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache)
+            {
+                return std::nullopt;
+            }
+        }
+        auto value = take(head);
+        m_head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    // Move up to `count` elements from `first` into the ring, published with a single index store. Returns how
+    // many were taken.
+    template <typename Iterator>
+    std::size_t try_push_bulk(Iterator first, std::size_t count)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (capacity() - (tail - m_headCache) < count)
+        {
+            m_headCache = m_head.load(std::memory_order_acquire);
+        }
+        count = std::min(count, capacity() - (tail - m_headCache));
+        for (std::size_t i = 0; i < count; ++i, ++first)
+        {
+            ::new (static_cast<void*>(m_slots[(tail + i) & m_mask].storage)) T(std::move(*first));
+        }
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Pop up to `count` elements into `out`, released with a single index store. Returns how many.
+    template <typename OutputIterator>
+    std::size_t try_pop_bulk(OutputIterator out, std::size_t count)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_tailCache - head < count)
+        {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+        }
+        count = std::min(count, m_tailCache - head);
+        for (std::size_t i = 0; i < count; ++i, ++out)
+        {
+            *out = take(head + i);
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // exact from either side, approximate from any other thread
+    [[nodiscard]] std::size_t size() const
+    {
+        const std::size_t head = m_head.load(std::memory_order_acquire);
+        const std::size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    T take(std::size_t index)
+    {
+        Slot& slot = m_slots[index & m_mask];
+        T value    = std::move(*slot.value());
+        slot.value()->~T();
+        return value;
+    }
+
+    const std::size_t m_mask;
+    const std::unique_ptr<Slot[]> m_slots;
+    // producer side
+    alignas(CacheLineSize) std::atomic<std::size_t> m_tail{ 0 };
+    std::size_t m_headCache = 0;
+    // consumer side
+    alignas(CacheLineSize) std::atomic<std::size_t> m_head{ 0 };
+    std::size_t m_tailCache = 0;
+};
+
+} // namespace ana
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "slabPool.h"
+
+namespace ana
+{
+
+// thrown by TaskFuture::get() when the task was cancelled before it started
+class TaskCancelled : public std::exception
+{
+public:
+    [[nodiscard]] const char* what() const noexcept override
+    {
+        return "task cancelled";
+    }
+};
+
+namespace threads
+{
+// Shared state of a TaskPromise/TaskFuture pair. States come from a per-type SlabPool, so creating a pair does
+// not hit the global heap once the slab is warm.
+template <typename R>
+class TaskState
+{
+    using Storage = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+    static auto& pool()
+    {
+        static SlabPool<sizeof(TaskState), alignof(TaskState)> s_pool;
+        return s_pool;
+    }
+
+public:
+    enum Status : std::uint32_t
+    {
+        Pending,
+        Value,
+        Error,
+        Cancelled,
+    };
+
+    static TaskState* create()
+    {
+        return ::new (pool().allocate()) TaskState();
+    }
+
+    void retain()
+    {
+        m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+        if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            this->~TaskState();
+            pool().deallocate(this);
+        }
+    }
+
+    template <typename... Args>
+    void setValue(Args&&... args)
+    {
+        m_value.emplace(std::forward<Args>(args)...);
+        publish(Value);
+    }
+
+    void setException(std::exception_ptr error)
+    {
+        m_error = std::move(error);
+        publish(Error);
+    }
+
+    void cancel()
+    {
+        publish(Cancelled);
+    }
+
+    void wait() const
+    {
+        auto status = m_status.load(std::memory_order_acquire);
+        while (status == Pending)
+        {
+            m_status.wait(status, std::memory_order_acquire);
+            status = m_status.load(std::memory_order_acquire);
+        }
+    }
+
+    [[nodiscard]] bool ready() const
+    {
+        return m_status.load(std::memory_order_acquire) != Pending;
+    }
+
+    [[nodiscard]] bool cancelled() const
+    {
+        return m_status.load(std::memory_order_acquire) == Cancelled;
+    }
+
+    Storage take()
+    {
+        wait();
+        switch (m_status.load(std::memory_order_relaxed))
+        {
+        case Error:
+            std::rethrow_exception(m_error);
+        case Cancelled:
+            throw TaskCancelled();
+        default:
+            break;
+        }
+        return std::move(*m_value);
+    }
+
+private:
+    void publish(Status status)
+    {
+        m_status.store(status, std::memory_order_release);
+        m_status.notify_all();
+    }
+
+    std::atomic<std::uint32_t> m_status{ Pending };
+    std::atomic<std::uint32_t> m_refs{ 1 };
+    std::optional<Storage> m_value;
+    std::exception_ptr m_error;
+};
+} // namespace threads
+
+// Lightweight replacement for std::future: one pooled shared state, no std::shared_ptr, waits on a futex.
+template <typename R>
+class TaskFuture
+{
+public:
+    TaskFuture() = default;
+
+    explicit TaskFuture(threads::TaskState<R>* state)
+        : m_state(state)
+    {
+    }
+
+    TaskFuture(TaskFuture&& other) noexcept
+        : m_state(std::exchange(other.m_state, nullptr))
+    {
+    }
+
+    TaskFuture& operator=(TaskFuture&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+
+    TaskFuture(const TaskFuture&)            = delete;
+    TaskFuture& operator=(const TaskFuture&) = delete;
+
+    ~TaskFuture()
+    {
+        reset();
+    }
+
+    [[nodiscard]] bool valid() const
+    {
+        return m_state != nullptr;
+    }
+
+    // also true once the task got cancelled
+    [[nodiscard]] bool ready() const
+    {
+        return m_state && m_state->ready();
+    }
+
+    [[nodiscard]] bool cancelled() const
+    {
+        return m_state && m_state->cancelled();
+    }
+
+    void wait() const
+    {
+        m_state->wait();
+    }
+
+    // like std::future::get(), invalidates the future. Throws TaskCancelled for a cancelled task.
+    R get()
+    {
+        auto* state = std::exchange(m_state, nullptr);
+        struct Release
+        {
+            threads::TaskState<R>* state;
+
+            ~Release()
+            {
+                state->release();
+            }
+        } guard{ state };
+
+        if constexpr (std::is_void_v<R>)
+        {
+            state->take();
+        }
+        else
+        {
+            return state->take();
+        }
+    }
+
+private:
+    void reset()
+    {
+        if (m_state)
+        {
+            std::exchange(m_state, nullptr)->release();
+        }
+    }
+
+    threads::TaskState<R>* m_state = nullptr;
+};
+
+template <typename R>
+class TaskPromise
+{
+public:
+    TaskPromise()
+        : m_state(threads::TaskState<R>::create())
+    {
+    }
+
+    TaskPromise(TaskPromise&& other) noexcept
+        : m_state(std::exchange(other.m_state, nullptr))
+    {
+    }
+
+    TaskPromise& operator=(TaskPromise&& other) noexcept
+    {
+        if (this != &other)
+        {
+            abandon();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+
+    TaskPromise(const TaskPromise&)            = delete;
+    TaskPromise& operator=(const TaskPromise&) = delete;
+
+    ~TaskPromise()
+    {
+        abandon();
+    }
+
+    [[nodiscard]] TaskFuture<R> getFuture()
+    {
+        m_state->retain();
+        return TaskFuture<R>{ m_state };
+    }
+
+    template <typename... Args>
+    void setValue(Args&&... args)
+    {
+        m_state->setValue(std::forward<Args>(args)...);
+    }
+
+    void setException(std::exception_ptr error)
+    {
+        m_state->setException(std::move(error));
+    }
+
+    // the task will never run
+    void cancel()
+    {
+        m_state->cancel();
+    }
+
+private:
+    void abandon()
+    {
+        if (!m_state)
+        {
+            return;
+        }
+        if (!m_state->ready())
+        {
+            m_state->setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+        std::exchange(m_state, nullptr)->release();
+    }
+
+    threads::TaskState<R>* m_state = nullptr;
+};
+
+} // namespace ana
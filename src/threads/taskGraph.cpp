@@ -0,0 +1,198 @@
+#include "taskGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace ana
+{
+
+TaskGraph::~TaskGraph()
+{
+    std::unique_lock lk(m_mutex);
+    m_done.wait(lk,
+                [this]
+                {
+                    return !m_running;
+                });
+}
+
+TaskGraph::Task TaskGraph::whenAll(std::initializer_list<Task> tasks)
+{
+    auto& join = m_nodes.emplace_back();
+    for (const auto& task : tasks)
+    {
+        link(task.m_node, &join);
+    }
+    return { this, &join };
+}
+
+TaskGraph::Task TaskGraph::whenAny(std::initializer_list<Task> tasks)
+{
+    auto& join = m_nodes.emplace_back();
+    join.any   = true;
+    for (const auto& task : tasks)
+    {
+        link(task.m_node, &join);
+    }
+    return { this, &join };
+}
+
+void TaskGraph::wait()
+{
+    std::unique_lock lk(m_mutex);
+    m_done.wait(lk,
+                [this]
+                {
+                    return !m_running;
+                });
+    if (m_error)
+    {
+        std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+}
+
+void TaskGraph::clear()
+{
+    wait();
+    m_nodes.clear();
+}
+
+void TaskGraph::link(Node* from, Node* to)
+{
+    assert(!m_running && "Cannot change a TaskGraph while it is running");
+    from->successors.push_back(to);
+    ++to->predecessors;
+    m_verified = false;
+}
+
+void TaskGraph::verify()
+{
+    // dry run of start() + execute() on the counters: every node has to become ready exactly once, a node that
+    // never does sits on a cycle and would keep wait() blocked forever
+    std::vector<Node*> ready;
+    for (auto& node : m_nodes)
+    {
+        const auto count = node.any ? std::min<std::uint32_t>(node.predecessors, 1) : node.predecessors;
+        node.pending.store(static_cast<std::int32_t>(count), std::memory_order_relaxed);
+        if (count == 0)
+        {
+            ready.push_back(&node);
+        }
+    }
+
+    std::size_t reached = 0;
+    while (!ready.empty())
+    {
+        Node* node = ready.back();
+        ready.pop_back();
+        ++reached;
+        for (auto* successor : node->successors)
+        {
+            if (successor->pending.fetch_sub(1, std::memory_order_relaxed) == 1)
+            {
+                ready.push_back(successor);
+            }
+        }
+    }
+
+    if (reached != m_nodes.size())
+    {
+        throw std::logic_error("TaskGraph has a dependency cycle");
+    }
+    m_verified = true;
+}
+
+void TaskGraph::start()
+{
+    if (!m_verified)
+    {
+        verify();
+    }
+
+    {
+        std::scoped_lock lk(m_mutex);
+        assert(!m_running && "TaskGraph is already running");
+        if (m_nodes.empty())
+        {
+            return;
+        }
+        m_running = true;
+        m_error   = nullptr;
+    }
+
+    for (auto& node : m_nodes)
+    {
+        const auto count = node.any ? std::min<std::uint32_t>(node.predecessors, 1) : node.predecessors;
+        node.pending.store(static_cast<std::int32_t>(count), std::memory_order_relaxed);
+    }
+    m_remaining.store(m_nodes.size(), std::memory_order_relaxed);
+
+    // collect roots first, a root may already finish and touch other counters while we are still iterating
+    std::vector<Node*> roots;
+    for (auto& node : m_nodes)
+    {
+        if (node.predecessors == 0)
+        {
+            roots.push_back(&node);
+        }
+    }
+    for (auto* root : roots)
+    {
+        m_submit(this, root);
+    }
+}
+
+void TaskGraph::execute(Node* node)
+{
+    while (node)
+    {
+        if (node->work)
+        {
+            try
+            {
+                node->work();
+            }
+            catch (...)
+            {
+                std::scoped_lock lk(m_mutex);
+                if (!m_error)
+                {
+                    m_error = std::current_exception();
+                }
+            }
+        }
+
+        // keep the first ready successor for ourselves, hand the rest to the pool
+        Node* next = nullptr;
+        for (auto* successor : node->successors)
+        {
+            if (successor->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                if (!next)
+                {
+                    next = successor;
+                }
+                else
+                {
+                    m_submit(this, successor);
+                }
+            }
+        }
+
+        finish();
+        node = next;
+    }
+}
+
+void TaskGraph::finish()
+{
+    if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        std::scoped_lock lk(m_mutex);
+        m_running = false;
+        m_done.notify_all();
+    }
+}
+
+} // namespace ana
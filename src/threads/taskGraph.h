@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ana
+{
+
+// Dependency graph of tasks executed on a ThreadPool. Nodes are built once and the graph can be run again every
+// frame without reallocating anything: run() only resets the per-node dependency counters.
+//
+//   TaskGraph graph;
+//   auto cull   = graph.emplace([] { ... });
+//   auto sort   = cull.then([] { ... });
+//   auto record = graph.emplace([] { ... }).succeed(sort);
+//   graph.whenAll({ record, upload }).then([] { submit(); });
+//   graph.runAndWait(pool);
+//
+// A finished node enqueues its ready successors and keeps running one of them inline, so no worker ever blocks
+// on another task.
+class TaskGraph
+{
+    struct Node
+    {
+        std::function<void()> work;
+        std::vector<Node*> successors;
+        std::uint32_t predecessors = 0;
+        // when_any join: becomes ready with the first finished predecessor
+        bool any = false;
+        std::atomic<std::int32_t> pending{ 0 };
+    };
+
+public:
+    class Task
+    {
+    public:
+        Task() = default;
+
+        // this task has to finish before `other` may start
+        Task& precede(Task other)
+        {
+            m_graph->link(m_node, other.m_node);
+            return *this;
+        }
+
+        // `other` has to finish before this task may start
+        Task& succeed(Task other)
+        {
+            m_graph->link(other.m_node, m_node);
+            return *this;
+        }
+
+        // continuation that runs after this task
+        template <typename Function>
+            requires std::invocable<Function>
+        Task then(Function&& func)
+        {
+            Task next = m_graph->emplace(std::forward<Function>(func));
+            precede(next);
+            return next;
+        }
+
+        [[nodiscard]] bool valid() const
+        {
+            return m_node != nullptr;
+        }
+
+    private:
+        friend class TaskGraph;
+
+        Task(TaskGraph* graph, Node* node)
+            : m_graph(graph)
+            , m_node(node)
+        {
+        }
+
+        TaskGraph* m_graph = nullptr;
+        Node* m_node       = nullptr;
+    };
+
+    TaskGraph() = default;
+    ~TaskGraph();
+
+    TaskGraph(const TaskGraph&)            = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    template <typename Function>
+        requires std::invocable<Function>
+    Task emplace(Function&& func)
+    {
+        auto& node = m_nodes.emplace_back();
+        node.work  = std::forward<Function>(func);
+        return { this, &node };
+    }
+
+    // empty node that becomes ready once every task in `tasks` has finished
+    Task whenAll(std::initializer_list<Task> tasks);
+
+    // empty node that becomes ready as soon as the first task in `tasks` has finished
+    Task whenAny(std::initializer_list<Task> tasks);
+
+    // schedule all root tasks on `pool`, returns immediately. Throws std::logic_error if some task can never
+    // become ready because it depends on itself through a cycle.
+    template <typename Pool>
+    void run(Pool& pool)
+    {
+        m_pool   = &pool;
+        m_submit = [](TaskGraph* graph, Node* node)
+        {
+            static_cast<Pool*>(graph->m_pool)
+                ->enqueueDetach(
+                    [graph, node]
+                    {
+                        graph->execute(node);
+                    });
+        };
+        start();
+    }
+
+    // block the calling thread until the current run has finished, rethrows the first task exception.
+    // Must not be called from a worker of the pool the graph runs on.
+    void wait();
+
+    template <typename Pool>
+    void runAndWait(Pool& pool)
+    {
+        run(pool);
+        wait();
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    void clear();
+
+private:
+    void link(Node* from, Node* to);
+    void verify();
+    void start();
+    void execute(Node* node);
+    void finish();
+
+    std::deque<Node> m_nodes;
+
+    void* m_pool                        = nullptr;
+    void (*m_submit)(TaskGraph*, Node*) = nullptr;
+    std::atomic<std::size_t> m_remaining{ 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    bool m_running = false;
+    // the links have been checked for cycles since the last change
+    bool m_verified = false;
+    std::exception_ptr m_error;
+};
+
+} // namespace ana
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <atomic>
 #include <concepts>
 #include <condition_variable>
@@ -10,21 +12,21 @@
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <source_location>
+#include <string_view>
 #include <syncstream>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#include "locks.h"
+
 namespace ana
 {
 
-template <typename Lock>
-concept is_lockable = requires(Lock&& lock) {
-    lock.lock();
-    lock.unlock();
-    { lock.try_lock() } -> std::convertible_to<bool>;
-};
-
+// Lock can be any is_lockable type, e.g. SpinLock or TicketLock for short critical sections, or ProfiledLock to
+// find out whether the queue is a hot spot. A ProfiledLock reports under the site that creates the queue, or under
+// the name passed to the constructor.
 template <typename T, typename Lock = std::mutex>
     requires is_lockable<Lock>
 class ThreadSafeQueue
@@ -33,16 +35,32 @@ public:
     using value_type = T;
     using size_type  = std::deque<T>::size_type;
 
+    ThreadSafeQueue()
+        requires(!std::constructible_from<Lock, std::source_location>)
+    = default;
+
+    ThreadSafeQueue(std::source_location where = std::source_location::current())
+        requires std::constructible_from<Lock, std::source_location>
+        : mutex_(where)
+    {
+    }
+
+    explicit ThreadSafeQueue(std::string_view site)
+        requires std::constructible_from<Lock, std::string_view>
+        : mutex_(site)
+    {
+    }
+
     void push_back(T&& value)
     {
         std::scoped_lock lck{ mutex_ };
-        data_.push_back(value);
+        data_.push_back(std::move(value));
     }
 
     void push_front(T&& value)
     {
         std::scoped_lock lck{ mutex_ };
-        data_.push_front(value);
+        data_.push_front(std::move(value));
     }
 
     [[nodiscard]] bool empty()
@@ -120,7 +138,7 @@ public:
     }
 
 private:
-    mutable std::mutex mutex_{};
+    mutable Lock mutex_{};
     std::deque<T> data_{};
 };
 } // namespace ana
@@ -1,14 +1,26 @@
+#pragma once
+
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <exception>
 #include <functional>
 #include <future>
+#include <latch>
 #include <memory>
-#include <semaphore.h>
-#include <semaphore>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
 #include <stop_token>
+#include <string>
 #include <thread>
 #include <tuple>
 #include <type_traits>
@@ -20,7 +32,16 @@
 #endif
 #endif
 
-#include "threadSafeQueue.h"
+#include "backoff.h"
+#include "cancellationGroup.h"
+#include "coroutine.h"
+#include "eventCount.h"
+#include "inplaceTask.h"
+#include "scratchArena.h"
+#include "slabPool.h"
+#include "taskFuture.h"
+#include "topology.h"
+#include "workStealingDeque.h"
 
 namespace ana
 {
@@ -31,6 +52,131 @@ using DefaultFunctionType = std::move_only_function<void()>;
 #else
 using DefaultFunctionType = std::function<void()>;
 #endif
+
+struct IdleStats
+{
+    // time spent spinning that ended without finding work, i.e. burnt CPU
+    std::uint64_t wastedSpinNs = 0;
+    // spins that found work before the worker had to park
+    std::uint64_t spinHits = 0;
+    // times a worker went to sleep on the eventcount
+    std::uint64_t parks = 0;
+};
+
+// Per-worker counters since construction or the last ThreadPool::resetWorkerStats()
+struct WorkerStats
+{
+    std::uint64_t executed = 0;
+    // executed tasks that were taken from another worker's queues
+    std::uint64_t stolen = 0;
+    // steal attempts on a victim that had nothing in a non-empty lane
+    std::uint64_t failedSteals = 0;
+    // spinning or parked without work, busyNs is the rest of the window
+    std::uint64_t idleNs = 0;
+    std::uint64_t busyNs = 0;
+    // most tasks seen queued on this worker (own deque or inbox) at once
+    std::int64_t queueHighWater = 0;
+};
+
+// Enqueue-to-start latency, only collected with PoolConfig::measureLatency. Bucket 0 counts latencies of 0ns,
+// bucket i > 0 the ones in [2^(i-1), 2^i) ns; the last bucket also takes everything above.
+struct LatencyHistogram
+{
+    static constexpr std::size_t BucketCount = 36;
+
+    std::array<std::uint64_t, BucketCount> buckets{};
+
+    [[nodiscard]] std::uint64_t count() const
+    {
+        std::uint64_t total = 0;
+        for (auto bucket : buckets)
+        {
+            total += bucket;
+        }
+        return total;
+    }
+
+    // upper bound in ns of the bucket holding the given percentile (0..100)
+    [[nodiscard]] std::uint64_t percentileNs(double percentile) const
+    {
+        const std::uint64_t total = count();
+        if (total == 0)
+        {
+            return 0;
+        }
+        const auto target  = std::max<std::uint64_t>(
+            1, static_cast<std::uint64_t>(std::ceil(static_cast<double>(total) * percentile / 100.0)));
+        std::uint64_t seen = 0;
+        std::size_t i      = 0;
+        for (; i + 1 < BucketCount; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= target)
+            {
+                break;
+            }
+        }
+        return i == 0 ? 0 : (std::uint64_t{ 1 } << i) - 1;
+    }
+};
+
+enum class Priority : std::uint8_t
+{
+    // work the current frame waits on, e.g. culling or command recording
+    Critical,
+    Normal,
+    // streaming, decoding, anything that may slip a frame; throttled near a frame deadline
+    Background,
+};
+
+inline constexpr std::size_t PriorityCount = 3;
+
+struct LaneStats
+{
+    // tasks queued but not started yet
+    std::int64_t depth = 0;
+    // highest depth since construction or the last resetLaneStats()
+    std::int64_t peakDepth = 0;
+};
+
+enum class Pinning
+{
+    // leave placement to the OS scheduler
+    None,
+    // restrict each worker to the CPUs of its NUMA node
+    Node,
+    // one dedicated CPU per worker
+    Core,
+};
+
+struct PoolConfig
+{
+    // 0 spawns one worker per usable (allowed and not reserved) CPU
+    unsigned workerCount = 0;
+    Pinning pinning      = Pinning::None;
+    // logical CPUs kept free of workers, e.g. for the main and render threads (see pinCurrentThread())
+    std::vector<unsigned> reservedCpus{};
+    // workers show up as "<namePrefix>-<id>" in top/perf/gdb
+    std::string namePrefix = "ana-worker";
+    // background tasks are throttled this long before a frame deadline, see ThreadPool::setFrameDeadline()
+    std::chrono::microseconds backgroundMargin{ 2000 };
+    // workers that may still run background tasks while throttled, at least one so the lane keeps draining
+    unsigned throttledBackgroundWorkers = 1;
+    // timestamp every task on enqueue for latencyHistogram(), costs two clock reads per task
+    bool measureLatency = false;
+    // called on the worker with any exception escaping a task (enqueueDetach() and plain FunctionType tasks),
+    // must not throw. Such exceptions are dropped without a handler.
+    std::function<void(std::exception_ptr)> exceptionHandler{};
+    // initial size of each worker's scratch arena (see threads::scratch()), it grows to what a frame needs
+    std::size_t scratchBytes = ScratchArena::DefaultBlockSize;
+};
+
+struct WorkerPlacement
+{
+    unsigned cpu  = 0;
+    unsigned node = 0;
+    std::vector<unsigned> affinity;
+};
 } // namespace threads
 
 template <typename FunctionType = threads::DefaultFunctionType, typename ThreadType = std::jthread>
@@ -39,58 +185,30 @@ class ThreadPool
 {
 public:
     explicit ThreadPool(const unsigned int& size_of_number = std::thread::hardware_concurrency())
-        : m_tasks(size_of_number)
+        : ThreadPool(threads::PoolConfig{ .workerCount = size_of_number })
+    {
+    }
+
+    explicit ThreadPool(threads::PoolConfig config)
+        : m_config(std::move(config))
+        , m_placement(planWorkers(m_config))
+        , m_tasks(m_placement.size())
     {
-        std::size_t current_id = 0;
-        for (size_t i = 0; i < size_of_number; ++i)
+        buildStealOrder();
+        for (std::size_t id = 0; id < m_tasks.size(); ++id)
         {
-            m_priority_queue.push_back(size_t(current_id));
             try
             {
                 m_threads.emplace_back(
-                    [&, id = current_id](const std::stop_token& stop_tok)
+                    [this, id](const std::stop_token& stop_tok)
                     {
-                        do
-                        {
-                            // wait signal
-                            m_tasks[id].signal.acquire();
-                            do
-                            {
-                                while (auto task = m_tasks[id].tasks.pop_front())
-                                {
-                                    try
-                                    {
-                                        m_pending_tasks.fetch_sub(1, std::memory_order_release);
-                                        std::invoke(std::move(task.value()));
-                                    }
-                                    catch (...)
-                                    {
-                                    }
-                                }
-
-                                // steal task
-                                for (std::size_t j = 1; j < m_tasks.size(); ++j)
-                                {
-                                    const std::size_t index = (id + j) % m_tasks.size();
-                                    if (auto task = m_tasks[index].tasks.steal())
-                                    {
-                                        m_pending_tasks.fetch_sub(1, std::memory_order_release);
-                                        std::invoke(std::move(task.value()));
-                                        break;
-                                    }
-                                }
-                                // TODO
-                            } while (m_pending_tasks.load(std::memory_order_acquire) > 0);
-                            m_priority_queue.rotate_to_front(id);
-
-                        } while (!stop_tok.stop_requested());
+                        workerLoop(stop_tok, id);
                     });
-                ++current_id;
             }
             catch (...)
             {
-                m_tasks.pop_back();
-                std::ignore = m_priority_queue.pop_back();
+                // run with what we got, the queues of missing workers are still drained by stealing
+                break;
             }
         }
     }
@@ -98,11 +216,30 @@ public:
     ~ThreadPool()
 
     {
-        for (std::size_t i = 0; i < m_threads.size(); ++i)
+        for (auto& thread : m_threads)
+        {
+            thread.request_stop();
+        }
+        m_idle.notifyAll();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+
+        // drop whatever was never picked up
+        for (auto& item : m_tasks)
         {
-            m_threads[i].request_stop();
-            m_tasks[i].signal.release();
-            m_threads[i].join();
+            for (auto& queues : item.lanes)
+            {
+                while (auto task = queues.tasks.pop_back())
+                {
+                    destroyTask(task.value());
+                }
+                while (auto task = queues.inbox.steal())
+                {
+                    destroyTask(task.value());
+                }
+            }
         }
     }
 
@@ -112,6 +249,13 @@ public:
     template <typename Function, typename... Args, typename ReturnType = std::invoke_result_t<Function&&, Args&&...>>
         requires std::invocable<Function, Args...>
     [[nodiscard]] std::future<ReturnType> enqueue(Function f, Args... args)
+    {
+        return enqueue(threads::Priority::Normal, std::move(f), std::move(args)...);
+    }
+
+    template <typename Function, typename... Args, typename ReturnType = std::invoke_result_t<Function&&, Args&&...>>
+        requires std::invocable<Function, Args...>
+    [[nodiscard]] std::future<ReturnType> enqueue(threads::Priority priority, Function f, Args... args)
     {
 #ifdef __cpp_lib_move_only_function
         // we can do this in C++23 because we now have support for move only functions
@@ -136,7 +280,7 @@ public:
                 promise.set_exception(std::current_exception());
             }
         };
-        enqueue_task(std::move(task));
+        enqueueTask(priority, std::move(task));
         return future;
 #else
         /*
@@ -173,7 +317,7 @@ public:
         // get the future before enqueuing the task
         auto future = shared_promise->get_future();
         // enqueue the task
-        enqueueTask(std::move(task));
+        enqueueTask(priority, std::move(task));
         return future;
 #endif
     }
@@ -182,18 +326,278 @@ public:
         requires std::invocable<Function, Args...> && std::is_same_v<void, std::invoke_result_t<Function&&, Args&&...>>
     void enqueueDetach(Function&& func, Args&&... args)
     {
-        enqueueTask(std::move(
+        enqueueDetach(threads::Priority::Normal, std::forward<Function>(func), std::forward<Args>(args)...);
+    }
+
+    template <typename Function, typename... Args>
+        requires std::invocable<Function, Args...> && std::is_same_v<void, std::invoke_result_t<Function&&, Args&&...>>
+    void enqueueDetach(threads::Priority priority, Function&& func, Args&&... args)
+    {
+        // exceptions end up in PoolConfig::exceptionHandler
+        enqueueTask(priority, std::move(
             [f = std::forward<Function>(func), ... largs = std::forward<Args>(args)]() mutable -> decltype(auto)
             {
-                // suppress exceptions
+                std::invoke(f, largs...);
+            }));
+    }
+
+    // Dropped without running if `token` is stopped before the task starts. A function taking a std::stop_token
+    // as first argument gets the token to stop early by itself.
+    template <typename Function, typename... Args>
+        requires threads::StoppableTask<Function, Args...> &&
+                 std::is_same_v<void, threads::StoppableResult<Function, Args...>>
+    void enqueueDetach(std::stop_token token, Function&& func, Args&&... args)
+    {
+        enqueueDetach(threads::Priority::Normal, std::move(token), std::forward<Function>(func),
+                      std::forward<Args>(args)...);
+    }
+
+    template <typename Function, typename... Args>
+        requires threads::StoppableTask<Function, Args...> &&
+                 std::is_same_v<void, threads::StoppableResult<Function, Args...>>
+    void enqueueDetach(threads::Priority priority, std::stop_token token, Function&& func, Args&&... args)
+    {
+        enqueueTask(priority,
+                    [token = std::move(token), f = std::forward<Function>(func),
+                     ... largs = std::forward<Args>(args)]() mutable
+                    {
+                        if (!token.stop_requested())
+                        {
+                            threads::invokeWithToken(f, token, largs...);
+                        }
+                    });
+    }
+
+    // Like enqueue(), but returns a pooled TaskFuture instead of a std::future. With a FunctionType that takes
+    // move-only callables (InplaceTask or std::move_only_function) submitting a small callable does not allocate;
+    // a copyable one like std::function gets the promise behind a shared_ptr, as enqueue() does.
+    template <typename Function, typename... Args, typename ReturnType = std::invoke_result_t<Function&&, Args&&...>>
+        requires std::invocable<Function, Args...>
+    [[nodiscard]] TaskFuture<ReturnType> submit(Function f, Args... args)
+    {
+        return submit(threads::Priority::Normal, std::move(f), std::move(args)...);
+    }
+
+    template <typename Function, typename... Args, typename ReturnType = std::invoke_result_t<Function&&, Args&&...>>
+        requires std::invocable<Function, Args...>
+    [[nodiscard]] TaskFuture<ReturnType> submit(threads::Priority priority, Function f, Args... args)
+    {
+        TaskPromise<ReturnType> pending;
+        auto future = pending.getFuture();
+        enqueueTask(
+            priority,
+            [func = std::move(f), ... largs = std::move(args), held = holdPromise(std::move(pending))]() mutable
+            {
+                auto& promise = promiseOf(held);
                 try
                 {
-                    std::invoke(f, largs...);
+                    if constexpr (std::is_same_v<ReturnType, void>)
+                    {
+                        func(largs...);
+                        promise.setValue();
+                    }
+                    else
+                    {
+                        promise.setValue(func(largs...));
+                    }
                 }
                 catch (...)
                 {
+                    promise.setException(std::current_exception());
                 }
-            }));
+            });
+        return future;
+    }
+
+    // Like submit(), but the task is dropped without running if `token` is stopped before it starts and the future
+    // then reports cancelled(). A function taking a std::stop_token as first argument gets the token to stop early
+    // by itself, see CancellationGroup.
+    template <typename Function, typename... Args>
+        requires threads::StoppableTask<Function, Args...>
+    [[nodiscard]] auto submit(std::stop_token token, Function f, Args... args)
+    {
+        return submit(threads::Priority::Normal, std::move(token), std::move(f), std::move(args)...);
+    }
+
+    template <typename Function, typename... Args,
+              typename ReturnType = threads::StoppableResult<Function, Args...>>
+        requires threads::StoppableTask<Function, Args...>
+    [[nodiscard]] TaskFuture<ReturnType> submit(threads::Priority priority, std::stop_token token, Function f,
+                                                Args... args)
+    {
+        TaskPromise<ReturnType> pending;
+        auto future = pending.getFuture();
+        enqueueTask(
+            priority,
+            [token = std::move(token), func = std::move(f), ... largs = std::move(args),
+             held = holdPromise(std::move(pending))]() mutable
+            {
+                auto& promise = promiseOf(held);
+                if (token.stop_requested())
+                {
+                    promise.cancel();
+                    return;
+                }
+                try
+                {
+                    if constexpr (std::is_same_v<ReturnType, void>)
+                    {
+                        threads::invokeWithToken(func, token, largs...);
+                        promise.setValue();
+                    }
+                    else
+                    {
+                        promise.setValue(threads::invokeWithToken(func, token, largs...));
+                    }
+                }
+                catch (...)
+                {
+                    promise.setException(std::current_exception());
+                }
+            });
+        return future;
+    }
+
+    // Queue all of `tasks` (moved from) in one operation with a single wake-up per worker.
+    void enqueueBatch(std::span<FunctionType> tasks, threads::Priority priority = threads::Priority::Normal)
+    {
+        enqueueGenerated(priority, tasks.size(),
+                         [&](std::size_t i)
+                         {
+                             return std::move(tasks[i]);
+                         });
+    }
+
+    // Call fn over [begin, end) split into chunks of `grain` indices (0 picks a grain from the pool size) and wait
+    // for all of them. fn is either fn(chunkBegin, chunkEnd) or fn(i). The calling thread runs the first chunk
+    // itself and then helps draining the pool instead of just blocking.
+    template <std::integral Index, typename Function>
+        requires std::invocable<Function&, Index, Index> || std::invocable<Function&, Index>
+    void parallelFor(Index begin, Index end, Index grain, Function&& fn)
+    {
+        parallelFor(threads::Priority::Normal, begin, end, grain, std::forward<Function>(fn));
+    }
+
+    template <std::integral Index, typename Function>
+        requires std::invocable<Function&, Index, Index> || std::invocable<Function&, Index>
+    void parallelFor(threads::Priority priority, Index begin, Index end, Index grain, Function&& fn)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        const auto total = static_cast<std::size_t>(end - begin);
+        auto chunkSize   = static_cast<std::size_t>(grain);
+        if (chunkSize == 0)
+        {
+            chunkSize = std::max<std::size_t>(1, total / (std::max<std::size_t>(1, size()) * 4));
+        }
+        const std::size_t chunks = (total + chunkSize - 1) / chunkSize;
+
+        auto runChunk = [&fn, begin, total, chunkSize](std::size_t chunk)
+        {
+            const Index first = begin + static_cast<Index>(chunk * chunkSize);
+            const Index last  = static_cast<Index>(std::min<std::size_t>((chunk + 1) * chunkSize, total) + begin);
+            if constexpr (std::invocable<Function&, Index, Index>)
+            {
+                fn(first, last);
+            }
+            else
+            {
+                for (Index i = first; i != last; ++i)
+                {
+                    fn(i);
+                }
+            }
+        };
+
+        struct Join
+        {
+            explicit Join(std::ptrdiff_t count)
+                : done(count)
+            {
+            }
+
+            std::latch done;
+            std::atomic_flag failed;
+            std::exception_ptr error;
+        } join{ static_cast<std::ptrdiff_t>(chunks - 1) };
+
+        // a throwing chunk must still count down, the first exception is rethrown to the caller
+        auto guarded = [&runChunk, &join](std::size_t chunk)
+        {
+            try
+            {
+                runChunk(chunk);
+            }
+            catch (...)
+            {
+                if (!join.failed.test_and_set())
+                {
+                    join.error = std::current_exception();
+                }
+            }
+        };
+
+        enqueueGenerated(priority, chunks - 1,
+                         [&](std::size_t i)
+                         {
+                             return [&guarded, &join, chunk = i + 1]
+                             {
+                                 guarded(chunk);
+                                 join.done.count_down();
+                             };
+                         });
+
+        guarded(0);
+        while (!join.done.try_wait())
+        {
+            if (!runPendingTask())
+            {
+                join.done.wait();
+                break;
+            }
+        }
+
+        if (join.error)
+        {
+            std::rethrow_exception(join.error);
+        }
+    }
+
+    // co_await pool.schedule() moves the awaiting coroutine onto a worker of this pool
+    [[nodiscard]] auto schedule(threads::Priority priority = threads::Priority::Normal)
+    {
+        return threads::ScheduleAwaiter<ThreadPool, threads::Priority>{ *this, priority };
+    }
+
+    // co_await pool.whenAll(a, b) runs the tasks concurrently on this pool, see ana::whenAll()
+    template <typename... Ts>
+    [[nodiscard]] CoTask<std::tuple<threads::CoResult<Ts>...>> whenAll(CoTask<Ts>... tasks)
+    {
+        return ana::whenAll(*this, std::move(tasks)...);
+    }
+
+    template <typename T>
+    [[nodiscard]] auto whenAll(std::vector<CoTask<T>> tasks)
+    {
+        return ana::whenAll(*this, std::move(tasks));
+    }
+
+    // run a coroutine on this pool without waiting for it
+    void spawn(CoTask<void> task)
+    {
+        ana::spawn(*this, std::move(task));
+    }
+
+    // pass an exception nobody waits for to PoolConfig::exceptionHandler, or drop it without one
+    void handleException(std::exception_ptr error) const
+    {
+        if (m_config.exceptionHandler)
+        {
+            m_config.exceptionHandler(std::move(error));
+        }
     }
 
     [[nodiscard]] auto size() const
@@ -201,32 +605,679 @@ public:
         return m_threads.size();
     }
 
+    // summed over all workers since construction or the last resetIdleStats()
+    [[nodiscard]] threads::IdleStats idleStats() const
+    {
+        threads::IdleStats stats{};
+        for (const auto& item : m_tasks)
+        {
+            stats.wastedSpinNs += item.idle.wastedSpinNs.load(std::memory_order_relaxed);
+            stats.spinHits += item.idle.spinHits.load(std::memory_order_relaxed);
+            stats.parks += item.idle.parks.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    void resetIdleStats()
+    {
+        for (auto& item : m_tasks)
+        {
+            item.idle.wastedSpinNs.store(0, std::memory_order_relaxed);
+            item.idle.spinHits.store(0, std::memory_order_relaxed);
+            item.idle.parks.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // lock-free snapshot, the counters of one worker are not read atomically as a whole
+    [[nodiscard]] threads::WorkerStats workerStats(std::size_t worker) const
+    {
+        const auto& counters = m_tasks[worker].counters;
+        const auto now       = clockNow();
+
+        auto idle             = counters.idleNs.load(std::memory_order_relaxed);
+        const auto idleSince  = counters.idleSince.load(std::memory_order_relaxed);
+        const auto statsSince = m_statsSince.load(std::memory_order_relaxed);
+        if (idleSince != 0)
+        {
+            idle += static_cast<std::uint64_t>(now - std::max(idleSince, statsSince));
+        }
+        const auto window = static_cast<std::uint64_t>(now - statsSince);
+
+        threads::WorkerStats stats{};
+        stats.executed       = counters.executed.load(std::memory_order_relaxed);
+        stats.stolen         = counters.stolen.load(std::memory_order_relaxed);
+        stats.failedSteals   = counters.failedSteals.load(std::memory_order_relaxed);
+        stats.idleNs         = std::min(idle, window);
+        stats.busyNs         = window - stats.idleNs;
+        stats.queueHighWater = counters.queueHighWater.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    // summed over all workers
+    [[nodiscard]] threads::LatencyHistogram latencyHistogram() const
+    {
+        threads::LatencyHistogram histogram{};
+        for (const auto& item : m_tasks)
+        {
+            for (std::size_t i = 0; i < histogram.buckets.size(); ++i)
+            {
+                histogram.buckets[i] += item.counters.latency[i].load(std::memory_order_relaxed);
+            }
+        }
+        return histogram;
+    }
+
+    // start a new stats window, e.g. once per frame
+    void resetWorkerStats()
+    {
+        m_statsSince.store(clockNow(), std::memory_order_relaxed);
+        for (auto& item : m_tasks)
+        {
+            auto& counters = item.counters;
+            counters.executed.store(0, std::memory_order_relaxed);
+            counters.stolen.store(0, std::memory_order_relaxed);
+            counters.failedSteals.store(0, std::memory_order_relaxed);
+            counters.idleNs.store(0, std::memory_order_relaxed);
+            counters.queueHighWater.store(0, std::memory_order_relaxed);
+            for (auto& bucket : counters.latency)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Background tasks only trickle through (see PoolConfig::throttledBackgroundWorkers) from backgroundMargin
+    // before `deadline` until it has passed. Typically set once per frame to the expected present time.
+    void setFrameDeadline(std::chrono::steady_clock::time_point deadline)
+    {
+        m_frameDeadline.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    void clearFrameDeadline()
+    {
+        m_frameDeadline.store(0, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] threads::LaneStats laneStats(threads::Priority priority) const
+    {
+        const auto& lane = m_lanes[static_cast<std::size_t>(priority)];
+        return { std::max<std::int64_t>(0, lane.depth.load(std::memory_order_relaxed)),
+                 lane.peakDepth.load(std::memory_order_relaxed) };
+    }
+
+    void resetLaneStats()
+    {
+        for (auto& lane : m_lanes)
+        {
+            lane.peakDepth.store(lane.depth.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+
+    // Frame boundary for the worker scratch arenas: each worker resets its arena before the next task it picks up.
+    // Call once no task of the previous frame is still running, or it may get its scratch memory reused.
+    void resetScratch()
+    {
+        m_scratchEpoch.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] ScratchStats scratchStats(std::size_t worker) const
+    {
+        return m_tasks[worker].scratch.stats();
+    }
+
+    void resetScratchStats()
+    {
+        for (auto& item : m_tasks)
+        {
+            item.scratch.resetPeak();
+        }
+    }
+
 private:
+    // number of backoff rounds a worker spins for new work before parking
+    static constexpr std::uint32_t SpinLimit = 32;
+
+    static constexpr auto BackgroundLane = static_cast<std::size_t>(threads::Priority::Background);
+
+    // what the queues point to, slab allocated
+    struct QueuedTask
+    {
+        FunctionType work;
+        // clockNow() at enqueue with PoolConfig::measureLatency, 0 otherwise
+        std::int64_t enqueuedAt;
+    };
+
+    // a task taken from one of the lanes
+    struct Job
+    {
+        QueuedTask* task;
+        std::size_t lane;
+        bool stolen;
+    };
+
+    struct IdleCounters
+    {
+        std::atomic_uint64_t wastedSpinNs{};
+        std::atomic_uint64_t spinHits{};
+        std::atomic_uint64_t parks{};
+    };
+
+    // written by the owning worker (queueHighWater also by submitters), read by anyone
+    struct WorkerCounters
+    {
+        std::atomic_uint64_t executed{};
+        std::atomic_uint64_t stolen{};
+        std::atomic_uint64_t failedSteals{};
+        std::atomic_uint64_t idleNs{};
+        // clockNow() when the current idle period started, 0 while busy
+        std::atomic_int64_t idleSince{};
+        std::atomic_int64_t queueHighWater{};
+        std::array<std::atomic_uint64_t, threads::LatencyHistogram::BucketCount> latency{};
+    };
+
+    // TaskPromise is move-only, a copyable FunctionType can only hold it through a shared_ptr
+    template <typename R>
+    static auto holdPromise(TaskPromise<R> promise)
+    {
+        if constexpr (std::is_copy_constructible_v<FunctionType>)
+        {
+            return std::make_shared<TaskPromise<R>>(std::move(promise));
+        }
+        else
+        {
+            return promise;
+        }
+    }
+
+    template <typename R>
+    static TaskPromise<R>& promiseOf(TaskPromise<R>& promise)
+    {
+        return promise;
+    }
+
+    template <typename R>
+    static TaskPromise<R>& promiseOf(const std::shared_ptr<TaskPromise<R>>& promise)
+    {
+        return *promise;
+    }
+
+    static std::int64_t clockNow()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Spread the workers evenly over the usable CPUs. CPUs come sorted by NUMA node, so workers of one node get
+    // consecutive ids.
+    static std::vector<threads::WorkerPlacement> planWorkers(const threads::PoolConfig& config)
+    {
+        const auto topology = threads::queryCpuTopology();
+
+        std::vector<threads::CpuInfo> usable;
+        for (const auto& info : topology.cpus)
+        {
+            if (std::find(config.reservedCpus.begin(), config.reservedCpus.end(), info.cpu) ==
+                config.reservedCpus.end())
+            {
+                usable.push_back(info);
+            }
+        }
+        if (usable.empty())
+        {
+            usable = topology.cpus;
+        }
+
+        const std::size_t count = config.workerCount ? config.workerCount : usable.size();
+        std::vector<threads::WorkerPlacement> placement(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto& info = count <= usable.size() ? usable[i * usable.size() / count] : usable[i % usable.size()];
+
+            placement[i].cpu  = info.cpu;
+            placement[i].node = info.node;
+
+            switch (config.pinning)
+            {
+            case threads::Pinning::Core:
+                placement[i].affinity = { info.cpu };
+                break;
+            case threads::Pinning::Node:
+                for (const auto& other : usable)
+                {
+                    if (other.node == info.node)
+                    {
+                        placement[i].affinity.push_back(other.cpu);
+                    }
+                }
+                break;
+            case threads::Pinning::None:
+                break;
+            }
+        }
+        return placement;
+    }
+
+    // victims on the same NUMA node first, then the rest, both rotated to start after the thief itself
+    void buildStealOrder()
+    {
+        const std::size_t count = m_tasks.size();
+        for (std::size_t id = 0; id < count; ++id)
+        {
+            auto& victims = m_tasks[id].victims;
+            victims.reserve(count - 1);
+            for (bool local : { true, false })
+            {
+                for (std::size_t j = 1; j < count; ++j)
+                {
+                    const std::size_t other = (id + j) % count;
+                    if ((m_placement[other].node == m_placement[id].node) == local)
+                    {
+                        victims.push_back(other);
+                    }
+                }
+            }
+        }
+    }
+
+    void workerLoop(const std::stop_token& stop_tok, std::size_t id)
+    {
+        tls_pool          = this;
+        tls_worker        = id;
+        auto& idle        = m_tasks[id].idle;
+        auto& counters    = m_tasks[id].counters;
+        auto& scratch     = m_tasks[id].scratch;
+        auto scratchEpoch = m_scratchEpoch.load(std::memory_order_relaxed);
+
+        threads::setCurrentThreadName(m_config.namePrefix + "-" + std::to_string(id));
+        if (!m_placement[id].affinity.empty())
+        {
+            threads::pinCurrentThread(m_placement[id].affinity);
+        }
+        // allocated here so the pages land on the worker's node
+        scratch.reserve(m_config.scratchBytes);
+        threads::bindScratch(&scratch);
+
+        while (true)
+        {
+            auto job = findTask(id);
+            if (!job)
+            {
+                if (stop_tok.stop_requested())
+                {
+                    break;
+                }
+                // an idle period lasts from here to the next task, across spinning and any number of wake-ups
+                if (counters.idleSince.load(std::memory_order_relaxed) == 0)
+                {
+                    counters.idleSince.store(clockNow(), std::memory_order_relaxed);
+                }
+                job = spinForTask(id);
+            }
+
+            if (!job)
+            {
+                // re-check after announcing ourselves so a concurrent enqueue can't slip through unseen
+                auto key = m_idle.prepareWait();
+                job      = findTask(id);
+                if (!job)
+                {
+                    if (stop_tok.stop_requested())
+                    {
+                        m_idle.cancelWait();
+                        break;
+                    }
+                    idle.parks.fetch_add(1, std::memory_order_relaxed);
+                    m_idle.wait(key);
+                    continue;
+                }
+                m_idle.cancelWait();
+            }
+
+            if (const auto idleSince = counters.idleSince.load(std::memory_order_relaxed))
+            {
+                const auto since = std::max(idleSince, m_statsSince.load(std::memory_order_relaxed));
+                counters.idleNs.fetch_add(static_cast<std::uint64_t>(std::max<std::int64_t>(0, clockNow() - since)),
+                                          std::memory_order_relaxed);
+                counters.idleSince.store(0, std::memory_order_relaxed);
+            }
+            // only between top-level tasks, tasks run inline while waiting may still hold scratch memory
+            if (const auto epoch = m_scratchEpoch.load(std::memory_order_relaxed); epoch != scratchEpoch)
+            {
+                scratch.reset();
+                scratchEpoch = epoch;
+            }
+            runJob(job.value(), &counters);
+        }
+        threads::bindScratch(nullptr);
+    }
+
+    std::optional<Job> spinForTask(std::size_t id)
+    {
+        auto& idle       = m_tasks[id].idle;
+        const auto start = std::chrono::steady_clock::now();
+        Backoff backoff;
+        for (std::uint32_t i = 0; i < SpinLimit; ++i)
+        {
+            backoff.pause();
+            if (auto job = findTask(id))
+            {
+                idle.spinHits.fetch_add(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+        const auto spent = std::chrono::steady_clock::now() - start;
+        idle.wastedSpinNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count(),
+                                    std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    // Higher lanes first, each lane from the own queues and then from the victims. Empty lanes are skipped by
+    // their depth counter, which never drops below the number of tasks actually queued in the lane.
+    std::optional<Job> findTask(std::size_t id)
+    {
+        for (std::size_t lane = 0; lane < threads::PriorityCount; ++lane)
+        {
+            if (m_lanes[lane].depth.load(std::memory_order_relaxed) <= 0)
+            {
+                continue;
+            }
+
+            const bool background = lane == BackgroundLane;
+            if (background && !acquireBackgroundSlot())
+            {
+                continue;
+            }
+            if (auto job = findInLane(id, lane))
+            {
+                return job;
+            }
+            if (background)
+            {
+                m_backgroundRunning.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<Job> findInLane(std::size_t id, std::size_t lane)
+    {
+        if (auto task = popLocal(id, lane))
+        {
+            return Job{ task.value(), lane, false };
+        }
+
+        std::uint64_t failed = 0;
+        std::optional<Job> job;
+        for (std::size_t victim : m_tasks[id].victims)
+        {
+            if (auto task = stealFrom(victim, lane))
+            {
+                job = Job{ task.value(), lane, true };
+                break;
+            }
+            ++failed;
+        }
+        if (failed != 0)
+        {
+            m_tasks[id].counters.failedSteals.fetch_add(failed, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    [[nodiscard]] bool nearFrameDeadline() const
+    {
+        const auto deadline = m_frameDeadline.load(std::memory_order_relaxed);
+        if (deadline == 0)
+        {
+            return false;
+        }
+        const auto now    = std::chrono::steady_clock::now().time_since_epoch().count();
+        const auto margin = std::chrono::duration_cast<std::chrono::steady_clock::duration>(m_config.backgroundMargin);
+        return now < deadline && now + margin.count() >= deadline;
+    }
+
+    // Every worker running a background task holds a slot. Near a deadline only a few slots are handed out, the
+    // holders keep the lane draining so nothing gets stuck while the others park.
+    bool acquireBackgroundSlot()
+    {
+        if (!nearFrameDeadline())
+        {
+            m_backgroundRunning.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        const std::uint32_t limit = std::max(1u, m_config.throttledBackgroundWorkers);
+        std::uint32_t running     = m_backgroundRunning.load(std::memory_order_relaxed);
+        while (running < limit)
+        {
+            if (m_backgroundRunning.compare_exchange_weak(running, running + 1, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     template <typename Function>
-    void enqueueTask(Function&& f)
+    void enqueueTask(threads::Priority priority, Function&& f)
+    {
+        enqueueGenerated(priority, 1,
+                         [&](std::size_t)
+                         {
+                             return std::forward<Function>(f);
+                         });
+    }
+
+    // Build `count` tasks from gen(i) and queue them in one go. From a worker everything goes to its own deque and
+    // the other workers steal; from outside the pool the batch is split into one contiguous share per worker, so
+    // each inbox lock is taken once. Either way at most one sleeper per worker is woken.
+    template <typename Generator>
+    void enqueueGenerated(threads::Priority priority, std::size_t count, Generator&& gen)
     {
-        auto i_opt = m_priority_queue.copy_front_and_rotate_to_back();
-        if (!i_opt.has_value())
+        const std::size_t workers = m_tasks.size();
+        if (count == 0 || workers == 0)
         {
-            // would only be a problem if there are zero threads
             return;
         }
-        auto i = i_opt.value();
-        m_pending_tasks.fetch_add(1, std::memory_order_relaxed);
-        m_tasks[i].tasks.push_back(std::forward<Function>(f));
-        m_tasks[i].signal.release();
+
+        // count before publishing, see findTask()
+        const auto lane   = static_cast<std::size_t>(priority);
+        auto& counters    = m_lanes[lane];
+        const auto added  = static_cast<std::int64_t>(count);
+        const auto depth  = counters.depth.fetch_add(added, std::memory_order_relaxed) + added;
+        raiseMax(counters.peakDepth, depth);
+
+        const std::int64_t stamp = m_config.measureLatency ? clockNow() : 0;
+
+        // tasks spawned from one of our workers go to its own deque without any locking
+        if (tls_pool == this)
+        {
+            auto& item  = m_tasks[tls_worker];
+            auto& deque = item.lanes[lane].tasks;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                deque.push_back(::new (m_taskSlab.allocate()) QueuedTask{ FunctionType(gen(i)), stamp });
+            }
+            raiseMax(item.counters.queueHighWater, static_cast<std::int64_t>(deque.size()));
+            m_idle.notify(std::min(count, workers - 1));
+            return;
+        }
+
+        const std::size_t first  = m_nextWorker.fetch_add(1, std::memory_order_relaxed);
+        const std::size_t shares = std::min(count, workers);
+        std::size_t next         = 0;
+        for (std::size_t s = 0; s < shares; ++s)
+        {
+            auto& item              = m_tasks[(first + s) % workers];
+            auto& queues            = item.lanes[lane];
+            const std::size_t share = count / shares + (s < count % shares ? 1 : 0);
+            std::scoped_lock lk(queues.inboxMutex);
+            for (std::size_t i = 0; i < share; ++i, ++next)
+            {
+                queues.inbox.push_back(::new (m_taskSlab.allocate()) QueuedTask{ FunctionType(gen(next)), stamp });
+            }
+            raiseMax(item.counters.queueHighWater, static_cast<std::int64_t>(queues.inbox.size()));
+        }
+        m_idle.notify(shares);
+    }
+
+    // run one queued task on the calling thread, used to help out instead of blocking
+    bool runPendingTask()
+    {
+        std::optional<Job> job;
+        WorkerCounters* counters = nullptr;
+        if (tls_pool == this)
+        {
+            job      = findTask(tls_worker);
+            counters = &m_tasks[tls_worker].counters;
+        }
+        else
+        {
+            // outside threads only help with frame and normal work
+            for (std::size_t lane = 0; lane < BackgroundLane && !job; ++lane)
+            {
+                for (std::size_t i = 0; i < m_tasks.size() && !job; ++i)
+                {
+                    if (auto task = stealFrom(i, lane))
+                    {
+                        job = Job{ task.value(), lane, true };
+                    }
+                }
+            }
+        }
+
+        if (!job)
+        {
+            return false;
+        }
+        runJob(job.value(), counters);
+        return true;
+    }
+
+    std::optional<QueuedTask*> popLocal(std::size_t id, std::size_t lane)
+    {
+        auto& queues = m_tasks[id].lanes[lane];
+        if (auto task = queues.tasks.pop_back())
+        {
+            return task;
+        }
+        return queues.inbox.steal();
+    }
+
+    std::optional<QueuedTask*> stealFrom(std::size_t index, std::size_t lane)
+    {
+        auto& queues = m_tasks[index].lanes[lane];
+        if (auto task = queues.tasks.steal())
+        {
+            return task;
+        }
+        return queues.inbox.steal();
     }
 
+    // counters is null for threads outside the pool
+    void runJob(const Job& job, WorkerCounters* counters)
+    {
+        m_lanes[job.lane].depth.fetch_sub(1, std::memory_order_relaxed);
+        if (counters)
+        {
+            counters->executed.fetch_add(1, std::memory_order_relaxed);
+            if (job.stolen)
+            {
+                counters->stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (job.task->enqueuedAt != 0)
+            {
+                const auto latency = static_cast<std::uint64_t>(std::max<std::int64_t>(0, clockNow() -
+                                                                                               job.task->enqueuedAt));
+                const auto bucket  = std::min<std::size_t>(std::bit_width(latency), counters->latency.size() - 1);
+                counters->latency[bucket].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        runTask(job.task);
+        if (job.lane == BackgroundLane)
+        {
+            m_backgroundRunning.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void runTask(QueuedTask* task)
+    {
+        try
+        {
+            std::invoke(std::move(task->work));
+        }
+        catch (...)
+        {
+            handleException(std::current_exception());
+        }
+        destroyTask(task);
+    }
+
+    void destroyTask(QueuedTask* task)
+    {
+        task->~QueuedTask();
+        m_taskSlab.deallocate(task);
+    }
+
+    static void raiseMax(std::atomic_int64_t& value, std::int64_t candidate)
+    {
+        std::int64_t current = value.load(std::memory_order_relaxed);
+        while (current < candidate && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    struct LaneQueues
+    {
+        // owner pushes/pops at the bottom, other workers steal from the top
+        ana::WorkStealingDeque<QueuedTask*> tasks{};
+        // submissions from threads outside the pool: producers serialize on the mutex and act as the deque's
+        // owner, every consumer (including this worker) takes from the top without locking. Unlike a std::deque
+        // the ring never gives memory back, so steady-state submission does not allocate.
+        ana::WorkStealingDeque<QueuedTask*> inbox{};
+        std::mutex inboxMutex;
+    };
+
     struct TaskItem
     {
-        ana::ThreadSafeQueue<FunctionType> tasks{};
-        std::binary_semaphore signal{ 0 };
+        // indexed by threads::Priority
+        std::array<LaneQueues, threads::PriorityCount> lanes{};
+        IdleCounters idle{};
+        WorkerCounters counters{};
+        // what threads::scratch() returns inside tasks on this worker
+        ScratchArena scratch{};
+        // steal order, see buildStealOrder()
+        std::vector<std::size_t> victims;
+    };
+
+    struct alignas(CacheLineSize) LaneCounters
+    {
+        std::atomic_int64_t depth{};
+        std::atomic_int64_t peakDepth{};
     };
 
+    static inline thread_local const ThreadPool* tls_pool = nullptr;
+    static inline thread_local std::size_t tls_worker     = 0;
+
+    threads::PoolConfig m_config;
+    std::vector<threads::WorkerPlacement> m_placement;
     std::vector<ThreadType> m_threads;
     std::deque<TaskItem> m_tasks;
-    ana::ThreadSafeQueue<std::size_t> m_priority_queue;
-    std::atomic_int_fast64_t m_pending_tasks{};
+    // round-robin cursor for submissions from outside the pool
+    std::atomic_size_t m_nextWorker{ 0 };
+    std::array<LaneCounters, threads::PriorityCount> m_lanes{};
+    // workers currently holding a background slot, see acquireBackgroundSlot()
+    std::atomic_uint32_t m_backgroundRunning{ 0 };
+    // steady_clock ticks, 0 when no deadline is set
+    std::atomic<std::chrono::steady_clock::rep> m_frameDeadline{ 0 };
+    EventCount m_idle;
+    // backing storage for queued tasks, queues only hold pointers into it
+    SlabPool<sizeof(QueuedTask), alignof(QueuedTask)> m_taskSlab;
+    // bumped by resetScratch()
+    std::atomic_uint64_t m_scratchEpoch{ 0 };
+    // start of the current WorkerStats window
+    std::atomic_int64_t m_statsSince{ clockNow() };
 };
 
 } // namespace ana
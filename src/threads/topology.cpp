@@ -0,0 +1,163 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ana::threads
+{
+
+namespace
+{
+// parse sysfs range lists like "0-3,8-11", used for cpu and node lists
+std::vector<unsigned> parseRangeList(const std::string& list)
+{
+    std::vector<unsigned> values;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty() || range == "\n")
+        {
+            continue;
+        }
+        const auto dash  = range.find('-');
+        const auto first = static_cast<unsigned>(std::stoul(range.substr(0, dash)));
+        const auto last =
+            dash == std::string::npos ? first : static_cast<unsigned>(std::stoul(range.substr(dash + 1)));
+        for (unsigned value = first; value <= last; ++value)
+        {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+std::vector<unsigned> readRangeList(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string list;
+    if (!file || !std::getline(file, list))
+    {
+        return {};
+    }
+    return parseRangeList(list);
+}
+
+std::vector<unsigned> currentThreadCpus()
+{
+    std::vector<unsigned> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty())
+    {
+        const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < count; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// The process mask. sched_getaffinity() reports the calling thread and /proc/self/status the main thread, and the
+// main thread is typically pinned to a reserved CPU before the pool is built, so the mask is taken at startup.
+const std::vector<unsigned>& allowedCpus()
+{
+    static const std::vector<unsigned> cpus = currentThreadCpus();
+    return cpus;
+}
+
+// runs with the other static initializers, before main() had a chance to pin itself
+[[maybe_unused]] const auto& StartupCpus = allowedCpus();
+} // namespace
+
+CpuTopology queryCpuTopology()
+{
+    CpuTopology topology;
+    for (unsigned cpu : allowedCpus())
+    {
+        topology.cpus.push_back({ cpu, 0 });
+    }
+
+#if defined(__linux__)
+    // node ids may be sparse (e.g. "0,2" with a memory-only or offline node in between)
+    const auto nodes = readRangeList("/sys/devices/system/node/online");
+    for (unsigned node : nodes)
+    {
+        for (unsigned cpu : readRangeList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))
+        {
+            auto it = std::find_if(topology.cpus.begin(), topology.cpus.end(),
+                                   [cpu](const CpuInfo& info)
+                                   {
+                                       return info.cpu == cpu;
+                                   });
+            if (it != topology.cpus.end())
+            {
+                it->node = node;
+            }
+        }
+    }
+    topology.nodeCount = std::max<std::size_t>(1, nodes.size());
+#endif
+
+    std::stable_sort(topology.cpus.begin(), topology.cpus.end(),
+                     [](const CpuInfo& a, const CpuInfo& b)
+                     {
+                         return a.node < b.node;
+                     });
+    return topology;
+}
+
+bool pinCurrentThread(const std::vector<unsigned>& cpus)
+{
+#if defined(__linux__)
+    if (cpus.empty())
+    {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+void setCurrentThreadName(const std::string& name)
+{
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#else
+    (void)name;
+#endif
+}
+
+} // namespace ana::threads
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ana::threads
+{
+
+struct CpuInfo
+{
+    unsigned cpu  = 0;
+    unsigned node = 0;
+};
+
+struct CpuTopology
+{
+    // CPUs the process may run on, grouped by NUMA node (ascending node, then cpu)
+    std::vector<CpuInfo> cpus;
+    std::size_t nodeCount = 1;
+};
+
+// Reads the affinity mask the process started with and the NUMA layout from sysfs. Pinning threads afterwards,
+// including the calling one, doesn't change the result. Falls back to one node holding
+// hardware_concurrency() CPUs where that information is not available.
+CpuTopology queryCpuTopology();
+
+// Restrict the calling thread to the given logical CPUs. Returns false if the platform refused or is unsupported.
+bool pinCurrentThread(const std::vector<unsigned>& cpus);
+
+inline bool pinCurrentThread(unsigned cpu)
+{
+    return pinCurrentThread(std::vector<unsigned>{ cpu });
+}
+
+// OS-visible thread name (shows up in top, perf, gdb). Linux truncates to 15 characters.
+void setCurrentThreadName(const std::string& name);
+
+} // namespace ana::threads
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ana
+{
+
+inline constexpr std::size_t CacheLineSize = 64;
+
+// Lock-free Chase-Lev work-stealing deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+// Models", PPoPP'13). The owning thread pushes and pops at the bottom, any other thread steals from the top.
+// Elements are kept in atomic slots, so T must be trivially copyable (typically a pointer to the real task).
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class WorkStealingDeque
+{
+    struct Ring
+    {
+        explicit Ring(std::int64_t cap)
+            : capacity(cap)
+            , mask(cap - 1)
+            , slots(std::make_unique<std::atomic<T>[]>(static_cast<std::size_t>(cap)))
+        {
+        }
+
+        void put(std::int64_t i, T value)
+        {
+            slots[i & mask].store(value, std::memory_order_relaxed);
+        }
+
+        T get(std::int64_t i) const
+        {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] Ring* grow(std::int64_t bottom, std::int64_t top) const
+        {
+            auto* ring = new Ring(capacity * 2);
+            for (std::int64_t i = top; i != bottom; ++i)
+            {
+                ring->put(i, get(i));
+            }
+            return ring;
+        }
+
+        std::int64_t capacity;
+        std::int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    // capacity must be a power of two, the ring doubles whenever it runs full
+    explicit WorkStealingDeque(std::int64_t capacity = 1024)
+    {
+        auto* ring = new Ring(capacity);
+        m_retired.emplace_back(ring);
+        m_ring.store(ring, std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&)            = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // owner only
+    void push_back(T value)
+    {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = m_top.load(std::memory_order_acquire);
+        Ring* ring           = m_ring.load(std::memory_order_relaxed);
+
+        if (b - t > ring->capacity - 1)
+        {
+            // thieves may still be reading the old ring, keep it alive until the deque dies
+            ring = ring->grow(b, t);
+            m_retired.emplace_back(ring);
+            m_ring.store(ring, std::memory_order_release);
+        }
+
+        ring->put(b, value);
+        // release store rather than fence + relaxed store: same cost on x86, and visible to ThreadSanitizer
+        m_bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // owner only, LIFO end
+    [[nodiscard]] std::optional<T> pop_back()
+    {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Ring* ring           = m_ring.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // empty
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        std::optional<T> item = ring->get(b);
+        if (t == b)
+        {
+            // last element, race against thieves for it
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                item.reset();
+            }
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // any thread, FIFO end. May spuriously return nullopt when losing a race with another thief.
+    [[nodiscard]] std::optional<T> steal()
+    {
+        std::int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+        {
+            return std::nullopt;
+        }
+
+        Ring* ring = m_ring.load(std::memory_order_acquire);
+        T item     = ring->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return std::nullopt;
+        }
+        return item;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // approximate when called concurrently
+    [[nodiscard]] size_type size() const
+    {
+        const std::int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_type>(b - t) : 0;
+    }
+
+    [[nodiscard]] std::int64_t capacity() const
+    {
+        return m_ring.load(std::memory_order_relaxed)->capacity;
+    }
+
+private:
+    alignas(CacheLineSize) std::atomic<std::int64_t> m_top{ 0 };
+    alignas(CacheLineSize) std::atomic<std::int64_t> m_bottom{ 0 };
+    alignas(CacheLineSize) std::atomic<Ring*> m_ring{ nullptr };
+    std::vector<std::unique_ptr<Ring>> m_retired;
+};
+
+} // namespace ana
@@ -0,0 +1,458 @@
+#include "wsi/inputRecording.h"
+
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ana::wsi
+{
+
+namespace
+{
+static_assert(std::endian::native == std::endian::little, "the input log is written in host byte order");
+
+enum class RecordKind : uint8_t
+{
+    Frame,
+    Key,
+    MouseMove,
+    MouseButton,
+    Resize
+};
+
+constexpr char Magic[4] = { 'A', 'N', 'A', 'I' };
+// flush once this much is buffered
+constexpr size_t FlushBytes = 64 * 1024;
+
+template <typename T>
+void put(std::vector<char>& out, T value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+class LogReader
+{
+public:
+    LogReader(const std::vector<char>& data, const std::string& path)
+        : data(data)
+        , path(path)
+    {
+    }
+
+    bool done() const
+    {
+        return pos == data.size();
+    }
+
+    template <typename T>
+    T get()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (data.size() - pos < sizeof(T))
+        {
+            fail("cut short");
+        }
+        T value;
+        std::memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    // a uint of type T that has to be below Count, as the enum
+    template <typename Enum, typename T>
+    Enum getEnum()
+    {
+        const auto raw = get<T>();
+        if (raw >= static_cast<T>(Enum::Count))
+        {
+            fail("holds an out of range value");
+        }
+        return static_cast<Enum>(raw);
+    }
+
+    [[noreturn]] void fail(const char* what) const
+    {
+        throw std::runtime_error("input log " + path + " " + what);
+    }
+
+private:
+    const std::vector<char>& data;
+    const std::string& path;
+    size_t pos = 0;
+};
+
+std::chrono::nanoseconds since(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - start);
+}
+
+// Window, surface and extent of the wrapped IWSI, input handed on through deliver()
+class ForwardingWSI : public IWSI
+{
+public:
+    explicit ForwardingWSI(std::unique_ptr<IWSI> inner)
+        : inner(std::move(inner))
+    {
+    }
+
+    std::vector<const char*> getRequiredInstanceExtensions() const override
+    {
+        return inner->getRequiredInstanceExtensions();
+    }
+
+    VkSurfaceKHR createSurface(VkInstance instance) override
+    {
+        return inner->createSurface(instance);
+    }
+
+    VkExtent2D framebufferExtent() const override
+    {
+        return inner->framebufferExtent();
+    }
+
+    GLFWwindow* nativeHandle() const override
+    {
+        return inner->nativeHandle();
+    }
+
+protected:
+    // what a platform callback does with the event: input state first, then the sink
+    void deliver(const KeyboardEvent& e)
+    {
+        if (inputState)
+        {
+            inputState->setKey(e.m_key, e.m_keystate);
+        }
+        if (keySink)
+        {
+            keySink(e);
+        }
+    }
+
+    void deliver(const MouseMoveEvent& e)
+    {
+        if (inputState)
+        {
+            inputState->moveMouse(e.m_absX, e.m_absY, e.m_deltaX, e.m_deltaY);
+        }
+        if (mouseMoveSink)
+        {
+            mouseMoveSink(e);
+        }
+    }
+
+    void deliver(const MouseButtonEvent& e)
+    {
+        if (inputState)
+        {
+            inputState->setMouseButton(e.m_button, e.m_pressed);
+        }
+        if (mouseButtonSink)
+        {
+            mouseButtonSink(e);
+        }
+    }
+
+    void deliver(const WindowResizeEvent& e)
+    {
+        if (resizeSink)
+        {
+            resizeSink(e);
+        }
+    }
+
+    void publishInput()
+    {
+        if (inputState)
+        {
+            inputState->publish();
+        }
+    }
+
+    std::unique_ptr<IWSI> inner;
+};
+
+class RecordingWSI final : public ForwardingWSI
+{
+public:
+    RecordingWSI(std::unique_ptr<IWSI> wrapped, const std::string& path)
+        : ForwardingWSI(std::move(wrapped))
+        , log(path)
+    {
+        inner->setKeySink(
+            [this](const KeyboardEvent& e)
+            {
+                record(e);
+            });
+        inner->setMouseMoveSink(
+            [this](const MouseMoveEvent& e)
+            {
+                record(e);
+            });
+        inner->setMouseButtonSink(
+            [this](const MouseButtonEvent& e)
+            {
+                record(e);
+            });
+        inner->setResizeSink(
+            [this](const WindowResizeEvent& e)
+            {
+                record(e);
+            });
+    }
+
+    bool poll() override
+    {
+        const bool open = inner->poll();
+        log.write({ frame, since(start, std::chrono::steady_clock::now()), FrameMark{} });
+        ++frame;
+        publishInput();
+        return open;
+    }
+
+private:
+    template <typename TEvent>
+    void record(const TEvent& e)
+    {
+        log.write({ frame, since(start, e.m_timestamp), e });
+        deliver(e);
+    }
+
+    InputLogWriter log;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint32_t frame                              = 0;
+};
+
+class ReplayWSI final : public ForwardingWSI
+{
+public:
+    ReplayWSI(std::unique_ptr<IWSI> wrapped, const std::string& path)
+        : ForwardingWSI(std::move(wrapped))
+        , records(readInputLog(path))
+    {
+        // the window is real, its resizes are the ones the swapchain has to follow
+        inner->setResizeSink(
+            [this](const WindowResizeEvent& e)
+            {
+                deliver(e);
+            });
+    }
+
+    bool poll() override
+    {
+        if (!inner->poll() || next == records.size())
+        {
+            return false;
+        }
+
+        while (next < records.size())
+        {
+            const InputRecord& record = records[next++];
+            if (std::holds_alternative<FrameMark>(record.event))
+            {
+                frameTime = record.time - lastMark;
+                lastMark  = record.time;
+                break;
+            }
+            std::visit(
+                [this](const auto& e)
+                {
+                    using T = std::decay_t<decltype(e)>;
+                    if constexpr (!std::is_same_v<T, FrameMark> && !std::is_same_v<T, WindowResizeEvent>)
+                    {
+                        // a fresh copy, stamped now
+                        deliver(T(e));
+                    }
+                },
+                record.event);
+        }
+        publishInput();
+        return true;
+    }
+
+    std::optional<std::chrono::nanoseconds> recordedFrameTime() const override
+    {
+        return frameTime;
+    }
+
+private:
+    std::vector<InputRecord> records;
+    size_t next = 0;
+    std::chrono::nanoseconds lastMark{};
+    std::optional<std::chrono::nanoseconds> frameTime;
+};
+} // namespace
+
+InputLogWriter::InputLogWriter(const std::string& path)
+    : file(path, std::ios::binary | std::ios::trunc)
+{
+    if (!file)
+    {
+        throw std::runtime_error("failed to create input log " + path);
+    }
+    buffer.reserve(FlushBytes + 64);
+    buffer.insert(buffer.end(), std::begin(Magic), std::end(Magic));
+    put(buffer, Version);
+}
+
+InputLogWriter::~InputLogWriter()
+{
+    flush();
+}
+
+void InputLogWriter::write(const InputRecord& record)
+{
+    const auto header = [&](RecordKind kind)
+    {
+        put(buffer, kind);
+        put(buffer, record.frame);
+        put(buffer, static_cast<int64_t>(record.time.count()));
+    };
+    std::visit(
+        [&](const auto& e)
+        {
+            using T = std::decay_t<decltype(e)>;
+            if constexpr (std::is_same_v<T, FrameMark>)
+            {
+                header(RecordKind::Frame);
+            }
+            else if constexpr (std::is_same_v<T, KeyboardEvent>)
+            {
+                header(RecordKind::Key);
+                put(buffer, static_cast<uint16_t>(e.m_key));
+                put(buffer, static_cast<uint8_t>(e.m_keystate));
+            }
+            else if constexpr (std::is_same_v<T, MouseMoveEvent>)
+            {
+                header(RecordKind::MouseMove);
+                put(buffer, e.m_deltaX);
+                put(buffer, e.m_deltaY);
+                put(buffer, e.m_absX);
+                put(buffer, e.m_absY);
+            }
+            else if constexpr (std::is_same_v<T, MouseButtonEvent>)
+            {
+                header(RecordKind::MouseButton);
+                put(buffer, static_cast<uint8_t>(e.m_button));
+                put(buffer, static_cast<uint8_t>(e.m_pressed));
+                put(buffer, e.m_absX);
+                put(buffer, e.m_absY);
+            }
+            else
+            {
+                header(RecordKind::Resize);
+                put(buffer, e.m_width);
+                put(buffer, e.m_height);
+            }
+        },
+        record.event);
+
+    if (buffer.size() >= FlushBytes)
+    {
+        flush();
+    }
+}
+
+void InputLogWriter::flush()
+{
+    if (buffer.empty())
+    {
+        return;
+    }
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.flush();
+    buffer.clear();
+}
+
+std::vector<InputRecord> readInputLog(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("failed to open input log " + path);
+    }
+    const std::vector<char> data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+    LogReader in(data, path);
+    char magic[4];
+    for (char& c : magic)
+    {
+        c = in.get<char>();
+    }
+    if (std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+    {
+        in.fail("is not an input log");
+    }
+    if (in.get<uint32_t>() != InputLogWriter::Version)
+    {
+        in.fail("has an unsupported version");
+    }
+
+    std::vector<InputRecord> records;
+    while (!in.done())
+    {
+        const auto kind = in.get<uint8_t>();
+        InputRecord record;
+        record.frame = in.get<uint32_t>();
+        record.time  = std::chrono::nanoseconds(in.get<int64_t>());
+        switch (static_cast<RecordKind>(kind))
+        {
+        case RecordKind::Frame:
+            break;
+        case RecordKind::Key:
+        {
+            const auto key   = in.getEnum<Key, uint16_t>();
+            const auto state = in.getEnum<KeyState, uint8_t>();
+            record.event.emplace<KeyboardEvent>(key, state);
+            break;
+        }
+        case RecordKind::MouseMove:
+        {
+            const auto dx = in.get<float>();
+            const auto dy = in.get<float>();
+            const auto x  = in.get<float>();
+            const auto y  = in.get<float>();
+            record.event.emplace<MouseMoveEvent>(dx, dy, x, y);
+            break;
+        }
+        case RecordKind::MouseButton:
+        {
+            const auto button  = in.getEnum<MouseButton, uint8_t>();
+            const bool pressed = in.get<uint8_t>() != 0;
+            const auto x       = in.get<float>();
+            const auto y       = in.get<float>();
+            record.event.emplace<MouseButtonEvent>(button, x, y, pressed);
+            break;
+        }
+        case RecordKind::Resize:
+        {
+            const auto width  = in.get<uint32_t>();
+            const auto height = in.get<uint32_t>();
+            record.event.emplace<WindowResizeEvent>(width, height);
+            break;
+        }
+        default:
+            in.fail("holds an unknown record kind");
+        }
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+std::unique_ptr<IWSI> CreateRecordingWSI(std::unique_ptr<IWSI> inner, const std::string& path)
+{
+    return std::make_unique<RecordingWSI>(std::move(inner), path);
+}
+
+std::unique_ptr<IWSI> CreateReplayWSI(std::unique_ptr<IWSI> inner, const std::string& path)
+{
+    return std::make_unique<ReplayWSI>(std::move(inner), path);
+}
+
+} // namespace ana::wsi
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "event/event.h"
+#include "wsi/wsi.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace ana::wsi
+{
+// closes the events of one poll()
+struct FrameMark
+{
+};
+
+struct InputRecord
+{
+    // index of the poll() the event came out of
+    uint32_t frame = 0;
+    // since the recording started: the event's m_timestamp, for a FrameMark the end of the poll()
+    std::chrono::nanoseconds time{};
+    std::variant<FrameMark, KeyboardEvent, MouseMoveEvent, MouseButtonEvent, WindowResizeEvent> event;
+};
+
+// Binary input log. After the header ("ANAI", uint32 version) every record is
+//   uint8 kind, uint32 frame, int64 time in ns, payload
+// with the payload by kind: FrameMark none, KeyboardEvent uint16 key + uint8 state, MouseMoveEvent 4 floats
+// (dx, dy, x, y), MouseButtonEvent uint8 button + uint8 pressed + 2 floats (x, y), WindowResizeEvent 2 uint32.
+// Little endian and unpadded.
+class InputLogWriter
+{
+public:
+    static constexpr uint32_t Version = 1;
+
+    // throws std::runtime_error if the file can't be created
+    explicit InputLogWriter(const std::string& path);
+    ~InputLogWriter();
+
+    InputLogWriter(const InputLogWriter&)            = delete;
+    InputLogWriter& operator=(const InputLogWriter&) = delete;
+
+    void write(const InputRecord& record);
+    void flush();
+
+private:
+    std::ofstream file;
+    // records pile up here and go out in large writes
+    std::vector<char> buffer;
+};
+
+// the whole log in order, throws std::runtime_error if it is missing, of another version or cut short
+std::vector<InputRecord> readInputLog(const std::string& path);
+
+// Passes everything through to `inner` and logs every key, mouse and resize event it delivers to `path`, one
+// FrameMark per poll().
+std::unique_ptr<IWSI> CreateRecordingWSI(std::unique_ptr<IWSI> inner, const std::string& path);
+
+// Feeds the log at `path` back in place of the live input: each poll() delivers the events of one recorded frame
+// to the sinks and the input state and reports the recorded frame time through recordedFrameTime(). poll() returns
+// false once the log is used up. The window, surface and resizes stay those of `inner`; recorded resizes are not
+// replayed. Replayed events carry the time they are replayed at, not the recorded one.
+std::unique_ptr<IWSI> CreateReplayWSI(std::unique_ptr<IWSI> inner, const std::string& path);
+} // namespace ana::wsi
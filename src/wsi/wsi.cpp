@@ -1,4 +1,5 @@
 #include "wsi/wsi.h"
+#include "event/coalescing.h"
 #include "event/event.h"
 #include "event/input.h"
 #include "wsi/keymap.h"
@@ -8,6 +9,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -51,7 +53,7 @@ public:
                            [](GLFWwindow* w, int key, int, int action, int mods)
                            {
                                auto* self = static_cast<GLFWWSI*>(glfwGetWindowUserPointer(w));
-                               if (!self || !self->keySink)
+                               if (!self || (!self->keySink && !self->inputState))
                                    return;
 
                                (void)mods;
@@ -61,8 +63,15 @@ public:
                                    return;
 
                                ana::KeyState s = ana::wsi::fromGlfwAction(action);
+                               if (self->inputState)
+                               {
+                                   self->inputState->setKey(k, s);
+                               }
                                // TODO: handle mods if KeyboardEvent需要
-                               self->keySink(ana::KeyboardEvent{ k, s });
+                               if (self->keySink)
+                               {
+                                   self->keySink(ana::KeyboardEvent{ k, s });
+                               }
                            });
 
         // mouse move
@@ -70,7 +79,7 @@ public:
                                  [](GLFWwindow* w, double xpos, double ypos)
                                  {
                                      auto* self = static_cast<GLFWWSI*>(glfwGetWindowUserPointer(w));
-                                     if (!self || !self->mouseMoveSink)
+                                     if (!self)
                                          return;
 
                                      double dx         = xpos - self->lastCursorX;
@@ -78,9 +87,28 @@ public:
                                      self->lastCursorX = xpos;
                                      self->lastCursorY = ypos;
 
-                                     self->mouseMoveSink(
-                                         ana::MouseMoveEvent{ static_cast<float>(dx), static_cast<float>(dy),
-                                                              static_cast<float>(xpos), static_cast<float>(ypos) });
+                                     if (self->inputState)
+                                     {
+                                         self->inputState->moveMouse(static_cast<float>(xpos), static_cast<float>(ypos),
+                                                                     static_cast<float>(dx), static_cast<float>(dy));
+                                     }
+                                     if (!self->mouseMoveSink)
+                                         return;
+
+                                     ana::MouseMoveEvent e{ static_cast<float>(dx), static_cast<float>(dy),
+                                                            static_cast<float>(xpos), static_cast<float>(ypos) };
+                                     if (!self->coalesceInput)
+                                     {
+                                         self->mouseMoveSink(e);
+                                     }
+                                     else if (!self->pendingMove)
+                                     {
+                                         self->pendingMove = e;
+                                     }
+                                     else
+                                     {
+                                         ana::EventCoalescing<ana::MouseMoveEvent>::merge(*self->pendingMove, e);
+                                     }
                                  });
 
         // mouse button
@@ -88,7 +116,7 @@ public:
                                    [](GLFWwindow* w, int button, int action, int)
                                    {
                                        auto* self = static_cast<GLFWWSI*>(glfwGetWindowUserPointer(w));
-                                       if (!self || !self->mouseButtonSink)
+                                       if (!self || (!self->mouseButtonSink && !self->inputState))
                                            return;
 
                                        ana::MouseButton btn = ana::MouseButton::Left;
@@ -104,6 +132,16 @@ public:
                                            break;
                                        }
 
+                                       if (self->inputState)
+                                       {
+                                           self->inputState->setMouseButton(btn, action == GLFW_PRESS);
+                                       }
+                                       if (!self->mouseButtonSink)
+                                           return;
+
+                                       // keep the order: moves before the click go out first
+                                       self->flushPendingMove();
+
                                        double x = 0.0, y = 0.0;
                                        glfwGetCursorPos(w, &x, &y);
                                        self->mouseButtonSink(ana::MouseButtonEvent{
@@ -122,7 +160,11 @@ public:
                                            const uint32_t clampedH = height > 0 ? static_cast<uint32_t>(height) : 0;
                                            self->extent            = { clampedW, clampedH };
 
-                                           if (self->resizeSink)
+                                           if (self->coalesceInput)
+                                           {
+                                               self->pendingResize.emplace(clampedW, clampedH);
+                                           }
+                                           else if (self->resizeSink)
                                            {
                                                self->resizeSink(ana::WindowResizeEvent{ clampedW, clampedH });
                                            }
@@ -142,6 +184,19 @@ public:
     bool poll() override
     {
         glfwPollEvents();
+        flushPendingMove();
+        if (pendingResize)
+        {
+            if (resizeSink)
+            {
+                resizeSink(*pendingResize);
+            }
+            pendingResize.reset();
+        }
+        if (inputState)
+        {
+            inputState->publish();
+        }
         return window && !glfwWindowShouldClose(window);
     }
 
@@ -177,10 +232,25 @@ public:
     }
 
 private:
+    void flushPendingMove()
+    {
+        if (pendingMove)
+        {
+            if (mouseMoveSink)
+            {
+                mouseMoveSink(*pendingMove);
+            }
+            pendingMove.reset();
+        }
+    }
+
     GLFWwindow* window = nullptr;
     VkExtent2D extent{ 0, 0 };
     double lastCursorX = 0.0;
     double lastCursorY = 0.0;
+    // what the callbacks of the current poll() coalesced so far
+    std::optional<ana::MouseMoveEvent> pendingMove;
+    std::optional<ana::WindowResizeEvent> pendingResize;
 };
 
 std::unique_ptr<IWSI> CreateGLFWWSI(int width, int height, const char* title)
@@ -1,8 +1,11 @@
 #pragma once
 #include "event/event.h"
 #include "event/input.h"
+#include "event/inputState.h"
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -30,6 +33,13 @@ public:
 
     virtual GLFWwindow* nativeHandle() const = 0;
 
+    // Only set while replaying a recording: how long the frame last polled took when it was recorded, so a
+    // simulation stepped by it follows the recorded path however fast this run is.
+    virtual std::optional<std::chrono::nanoseconds> recordedFrameTime() const
+    {
+        return std::nullopt;
+    }
+
     void setKeySink(KeySink s)
     {
         keySink = std::move(s);
@@ -50,11 +60,27 @@ public:
         mouseMoveSink = std::move(s);
     }
 
+    // Fold the mouse moves and resizes of one poll() into a single event each (see EventCoalescing), on by
+    // default. Off, every platform callback reaches its sink.
+    void setInputCoalescing(bool enabled)
+    {
+        coalesceInput = enabled;
+    }
+
+    // Keys, mouse buttons and the cursor also go straight into `state`, published once per poll(). Works next to
+    // the sinks; nullptr detaches.
+    void setInputState(ana::InputState* state)
+    {
+        inputState = state;
+    }
+
 protected:
     KeySink keySink;
     ResizeSink resizeSink;
     MouseButtonSink mouseButtonSink;
     MouseMoveSink mouseMoveSink;
+    bool coalesceInput          = true;
+    ana::InputState* inputState = nullptr;
 };
 
 // Factory (GLFW implementation). Header declares it so app.cpp can create one.